@@ -11,9 +11,48 @@ namespace DeviceLibrary {
 
         public enum TASK_TYPE {
             TASK_TYPE_ANALOG_INPUT = 0,
-            TASK_TYPE_DIGITAL_INPUT
+            TASK_TYPE_DIGITAL_INPUT,
+            TASK_TYPE_ANALOG_OUTPUT,
+            TASK_TYPE_DIGITAL_OUTPUT
         }
 
+        [Flags]
+        public enum TASK_FLAG {
+            TASK_FLAG_NONE         = 0,
+            TASK_FLAG_SHARED_ARENA = 1,
+            TASK_FLAG_PLANAR       = 2
+        }
+
+        public enum SAMPLE_FORMAT {
+            SAMPLE_FORMAT_DEFAULT = 0,
+            SAMPLE_FORMAT_RAW_I16
+        }
+
+        public enum READER_PRIORITY {
+            READER_PRIORITY_DEFAULT = 0,
+            READER_PRIORITY_HIGH,
+            READER_PRIORITY_REALTIME,
+            READER_PRIORITY_MMCSS
+        }
+
+        public enum REPLAY_MODE {
+            REPLAY_MODE_REALTIME = 0,
+            REPLAY_MODE_FAST
+        }
+
+        public enum UNPACK_MODE {
+            UNPACK_MODE_NONE = 0,
+            UNPACK_MODE_BITSET,
+            UNPACK_MODE_BYTES
+        }
+
+        public const int THREAD_GROUP_SHARED = 0;
+        public const int THREAD_GROUP_OWN    = -1;
+
+        public const int LATENCY_BUCKETS = 24;
+        public const int DEPTH_HISTORY   = 256;
+        public const int MAX_ERROR_CODES = 16;
+
         [StructLayout(LayoutKind.Sequential, Pack = 0)]
         public struct HandleInfo {
             public int handle;
@@ -25,6 +64,123 @@ namespace DeviceLibrary {
             public IntPtr mutex_buffers;
 
             public int result;
+            public int flags;
+            public int pool_depth;
+            public int pool_max_bytes;
+            public int thread_group;
+            public uint affinity_mask;
+            public int thread_priority;
+            public int sample_format;
+            public int ring_samples;
+
+            [MarshalAs(UnmanagedType.LPWStr)]
+            public string record_path;
+
+            public int record_prealloc_mb;
+            public int prefill_buffers;
+
+            [MarshalAs(UnmanagedType.LPWStr)]
+            public string replay_path;
+
+            public int replay_mode;
+            public int replay_loop;
+            public int sync_group;
+            public int latency_target_us;
+            public int chunk_min;
+            public int unpack_mode;
+            public uint line_mask;
+            public uint edge_mask;
+            public int event_capacity;
+            public int decimation;
+
+            [MarshalAs(UnmanagedType.SysInt)]
+            public IntPtr filter_coeffs;
+            public int filter_taps;
+        }
+
+        [StructLayout(LayoutKind.Sequential, Pack = 0)]
+        public struct BufferLease {
+            public int id;
+
+            [MarshalAs(UnmanagedType.SysInt)]
+            public IntPtr data;
+
+            public int len;
+            public int offset;
+            public long sequence;
+            public long timestamp;
+            public long first_sample;
+            public int samples;
+            public int stride;
+        }
+
+        [StructLayout(LayoutKind.Sequential, Pack = 0)]
+        public struct ChannelView {
+            [MarshalAs(UnmanagedType.SysInt)]
+            public IntPtr first;
+            public int first_samples;
+
+            [MarshalAs(UnmanagedType.SysInt)]
+            public IntPtr second;
+            public int second_samples;
+
+            public long position;
+        }
+
+        [StructLayout(LayoutKind.Sequential, Pack = 0)]
+        public struct PoolStats {
+            public int depth;
+            public int max_depth;
+            public int free;
+            public int ready;
+            public int in_use_high_water;
+            public int grow_count;
+            public long overruns;
+            public long filled;
+            public long underruns;
+            public int chunk;
+        }
+
+        [StructLayout(LayoutKind.Sequential, Pack = 0)]
+        public struct TelemetryStats {
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = LATENCY_BUCKETS)]
+            public long[] read_histogram;
+
+            public long reads;
+            public long read_us_total;
+            public long read_us_max;
+            public long sleeps;
+
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = MAX_ERROR_CODES)]
+            public int[] error_codes;
+
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = MAX_ERROR_CODES)]
+            public long[] error_counts;
+
+            public long other_errors;
+        }
+
+        [StructLayout(LayoutKind.Sequential, Pack = 0)]
+        public struct DepthSample {
+            public long timestamp;
+            public int free;
+            public int ready;
+        }
+
+        [StructLayout(LayoutKind.Sequential, Pack = 0)]
+        public struct DigitalEvent {
+            public long sample;
+            public int channel;
+            public short line;
+            public short rising;
+        }
+
+        [StructLayout(LayoutKind.Sequential, Pack = 0)]
+        public struct RecordingStats {
+            public long bytes_written;
+            public long bytes_dropped;
+            public int blocks_free;
+            public int error;
         }
 
         [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
@@ -46,6 +202,262 @@ namespace DeviceLibrary {
             int size
         );
 
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int acquire_buffer(
+            int poll_handle,
+            int task_handle,
+            out BufferLease lease
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int acquire_buffer_wait(
+            int poll_handle,
+            int task_handle,
+            out BufferLease lease,
+            int timeout_ms
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int read_buffer_wait(
+            int poll_handle,
+            int task_handle,
+            IntPtr ptr_data,
+            int size,
+            int timeout_ms
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int read_buffer_info(
+            int poll_handle,
+            int task_handle,
+            IntPtr ptr_data,
+            int size,
+            int timeout_ms,
+            out BufferLease info
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int read_buffer_scaled(
+            int poll_handle,
+            int task_handle,
+            IntPtr ptr_data,
+            int size,
+            int timeout_ms,
+            out BufferLease info
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int get_scaling_coeffs(
+            int poll_handle,
+            int task_handle,
+            [MarshalAs(UnmanagedType.LPArray)] double[] coeffs,
+            int size
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern void scale_raw(
+            IntPtr src,
+            IntPtr dst,
+            int samples_per_chan,
+            int channels,
+            [MarshalAs(UnmanagedType.LPArray)] double[] coeffs,
+            int coeff_count
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern long get_timestamp_frequency();
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int wait_buffer(
+            int poll_handle,
+            int task_handle,
+            int timeout_ms
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int wait_any_buffer(
+            int poll_handle,
+            int timeout_ms
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern IntPtr get_ready_event(
+            int poll_handle,
+            int task_handle
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern IntPtr get_any_ready_event(
+            int poll_handle
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int release_buffer(
+            int poll_handle,
+            int task_handle,
+            int id
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int get_arena(
+            int poll_handle,
+            int task_handle,
+            out IntPtr arena_base,
+            out int arena_size
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int read_channel(
+            int poll_handle,
+            int task_handle,
+            int channel,
+            IntPtr ptr_data,
+            int max_samples,
+            out int read
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int peek_channel(
+            int poll_handle,
+            int task_handle,
+            int channel,
+            out ChannelView view
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int consume_channel(
+            int poll_handle,
+            int task_handle,
+            int channel,
+            int samples
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern long get_channel_dropped(
+            int poll_handle,
+            int task_handle,
+            int channel
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int read_events(
+            int poll_handle,
+            int task_handle,
+            [Out] DigitalEvent[] events,
+            int max_events,
+            out int read
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern long get_events_dropped(
+            int poll_handle,
+            int task_handle
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int register_reader(
+            int poll_handle,
+            int task_handle
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int unregister_reader(
+            int poll_handle,
+            int task_handle,
+            int reader
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int acquire_reader_buffer(
+            int poll_handle,
+            int task_handle,
+            int reader,
+            out BufferLease lease
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int release_reader_buffer(
+            int poll_handle,
+            int task_handle,
+            int reader,
+            int id
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int wait_reader(
+            int poll_handle,
+            int task_handle,
+            int reader,
+            int timeout_ms
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int wait_frame(
+            int poll_handle,
+            int group,
+            int timeout_ms
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int acquire_frame(
+            int poll_handle,
+            int group,
+            [Out] BufferLease[] leases,
+            int max_leases
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int release_frame(
+            int poll_handle,
+            int group,
+            BufferLease[] leases,
+            int count
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int acquire_write_buffer(
+            int poll_handle,
+            int task_handle,
+            out BufferLease lease
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int submit_write_buffer(
+            int poll_handle,
+            int task_handle,
+            int id,
+            int samples
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int get_pool_stats(
+            int poll_handle,
+            int task_handle,
+            out PoolStats stats
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int get_telemetry(
+            int poll_handle,
+            int task_handle,
+            out TelemetryStats stats
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int get_depth_history(
+            int poll_handle,
+            int task_handle,
+            [Out] DepthSample[] dest,
+            int max_samples
+        );
+
+        [DllImport("NILoop.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        public static extern int get_recording_stats(
+            int poll_handle,
+            int task_handle,
+            out RecordingStats stats
+        );
+
     }
 
 }
@@ -27,8 +27,6 @@ namespace DeviceLibrary {
         private Graph _graph;
         private readonly List<Node> _nodes = new List<Node>();
         private readonly Dictionary<Node, NodeState> _nodeStates = new Dictionary<Node, NodeState>();
-        private readonly Dictionary<NidaqSingleton.Device, IntPtr> _inputAnalogDataBuffers = new Dictionary<NidaqSingleton.Device, IntPtr>();
-        private readonly Dictionary<NidaqSingleton.Device, IntPtr> _inputDigitalDataBuffers = new Dictionary<NidaqSingleton.Device, IntPtr>();
         private volatile bool _stopThread;
         private Thread _pollThread;
 
@@ -116,7 +114,6 @@ namespace DeviceLibrary {
 
                 try {
                     task.CreateTask(grp);
-                    _inputAnalogDataBuffers.Add(task.Device, Marshal.AllocHGlobal(sizeof(double) * task.SamplesPerChannel * task.Nodes.Count));
                     foreach (var node in grp) node.SetBufferSize(task.SamplesPerChannel * task.Nodes.Count);
 
                 } catch (NidaqException) {
@@ -139,7 +136,6 @@ namespace DeviceLibrary {
 
                 try {
                     task.CreateTask(grp);
-                    _inputDigitalDataBuffers.Add(task.Device, Marshal.AllocHGlobal(sizeof(uint) * task.SamplesPerChannel * task.Nodes.Count));
                     foreach (var node in grp) node.SetBufferSize(task.SamplesPerChannel * task.Nodes.Count);
 
                 } catch (NidaqException) {
@@ -235,18 +231,6 @@ namespace DeviceLibrary {
                 if (task.State == SessionTaskState.Running) task.Stop();
                 task.DestroyTask();
             }
-
-            foreach (var buf in _inputAnalogDataBuffers) {
-                Marshal.FreeHGlobal(buf.Value);
-            }
-
-            foreach (var buf in _inputDigitalDataBuffers) {
-                Marshal.FreeHGlobal(buf.Value);
-            }
-
-            _inputAnalogDataBuffers.Clear();
-            _inputDigitalDataBuffers.Clear();
-
         }
 
         private void EveryNCallback() {
@@ -261,7 +245,10 @@ namespace DeviceLibrary {
                         samples_per_chan = task.SamplesPerChannel,
                         type             = (int)NILoop.TASK_TYPE.TASK_TYPE_ANALOG_INPUT,
                         result           = 0,
-                        mutex_buffers    = IntPtr.Zero
+                        mutex_buffers    = IntPtr.Zero,
+                        flags            = (int)NILoop.TASK_FLAG.TASK_FLAG_SHARED_ARENA,
+                        thread_group     = NILoop.THREAD_GROUP_OWN,
+                        thread_priority  = (int)NILoop.READER_PRIORITY.READER_PRIORITY_HIGH
                     }
                 );
             }
@@ -275,7 +262,10 @@ namespace DeviceLibrary {
                         samples_per_chan = task.SamplesPerChannel,
                         type             = (int)NILoop.TASK_TYPE.TASK_TYPE_DIGITAL_INPUT,
                         result           = 0,
-                        mutex_buffers    = IntPtr.Zero
+                        mutex_buffers    = IntPtr.Zero,
+                        flags            = (int)NILoop.TASK_FLAG.TASK_FLAG_SHARED_ARENA,
+                        thread_group     = NILoop.THREAD_GROUP_OWN,
+                        thread_priority  = (int)NILoop.READER_PRIORITY.READER_PRIORITY_HIGH
                     }
                 );
             }
@@ -283,20 +273,42 @@ namespace DeviceLibrary {
             var hPoll = NILoop.start_polling(dict.Values.ToArray(), dict.Count);
 
             while (!_stopThread) {
+                var processed = false;
+
                 foreach (var task in dict) {
                     if (task.Key is NidaqSessionAnalogIn) {
-                        ProcessInputData(task.Key.Nodes, task.Value, _inputAnalogDataBuffers[task.Key.Device], sizeof(double), hPoll);
+                        processed |= ProcessInputData(task.Key.Nodes, task.Value, sizeof(double), hPoll);
                     } else if (task.Key is NidaqSessionDigitalIn) {
-                        ProcessInputData(task.Key.Nodes, task.Value, _inputDigitalDataBuffers[task.Key.Device], sizeof(uint), hPoll);
+                        processed |= ProcessInputData(task.Key.Nodes, task.Value, sizeof(uint), hPoll);
                     }
                 }
+
+                // all queues empty: sleep until NILoop signals a new buffer.
+                // the timeout only bounds how long a stop request may take
+                if (!processed) {
+                    NILoop.wait_any_buffer(hPoll, 100);
+                }
+            }
+
+            foreach (var task in dict) {
+                NILoop.PoolStats stats;
+                if (NILoop.get_pool_stats(hPoll, task.Value.handle, out stats) == 0 && stats.overruns > 0) {
+                    System.Diagnostics.Debug.WriteLine(
+                        $"NILoop: task {task.Value.handle} ran out of buffers {stats.overruns} times " +
+                        $"(pool depth {stats.depth}/{stats.max_depth}, high water {stats.in_use_high_water})"
+                    );
+                }
             }
 
             NILoop.stop_polling(hPoll);
         }
 
-        private void ProcessInputData(IReadOnlyList<INidaqMetric> listeningPorts, NILoop.HandleInfo taskInfo, IntPtr buffer, int sample_size_bytes, int hPoll) {
-            var result = NILoop.read_buffer(hPoll, taskInfo.handle, buffer, sample_size_bytes * (taskInfo.samples_per_chan * listeningPorts.Count));
+        private bool ProcessInputData(IReadOnlyList<INidaqMetric> listeningPorts, NILoop.HandleInfo taskInfo, int sample_size_bytes, int hPoll) {
+            NILoop.BufferLease lease;
+
+            // the ports read straight from the native buffer, which stays
+            // leased to us until all of them have seen it
+            var result = NILoop.acquire_buffer(hPoll, taskInfo.handle, out lease);
             switch (result) {
                 case 3:
                 case 1:
@@ -307,15 +319,18 @@ namespace DeviceLibrary {
 
                 case 2:
                     // queue empty, ignore
-                    Thread.Sleep(1);
-                    break;
+                    return false;
 
                 case 0:
-                    var channelData = buffer;
-
-                    foreach (var port in listeningPorts) {
-                        ((IMetricInput)port).DistributeData(channelData, taskInfo.samples_per_chan);
-                        channelData = IntPtr.Add(channelData, sample_size_bytes * taskInfo.samples_per_chan);
+                    var channelData = lease.data;
+
+                    try {
+                        foreach (var port in listeningPorts) {
+                            ((IMetricInput)port).DistributeData(channelData, taskInfo.samples_per_chan);
+                            channelData = IntPtr.Add(channelData, sample_size_bytes * taskInfo.samples_per_chan);
+                        }
+                    } finally {
+                        NILoop.release_buffer(hPoll, taskInfo.handle, lease.id);
                     }
 
                     break;
@@ -328,6 +343,8 @@ namespace DeviceLibrary {
                     break;
 
             }
+
+            return true;
         }
 
         public void DigitalWrite(NidaqSingleton.Device dev, int channelNumber, double[] data, int offset, int samples) {
@@ -344,7 +361,10 @@ namespace DeviceLibrary {
                 if (written != samples) {
                     System.Diagnostics.Debug.WriteLine("Didn't write " + (samples - written));
                 }
-            } catch (NationalInstruments.DAQmx.DaqException e) {
+            } catch (NidaqException e) {
+                System.Diagnostics.Debug.WriteLine("Nidaq: Error while writing: " + e.Message);
+                SessionGraph.AsyncEmergencyStop(null);
+            } catch (TimeoutException e) {
                 System.Diagnostics.Debug.WriteLine("Nidaq: Error while writing: " + e.Message);
                 SessionGraph.AsyncEmergencyStop(null);
             }
@@ -364,7 +384,10 @@ namespace DeviceLibrary {
                 if (written != samples) {
                     System.Diagnostics.Debug.WriteLine("Didn't write " + (samples - written));
                 }
-            } catch (NationalInstruments.DAQmx.DaqException e) {
+            } catch (NidaqException e) {
+                System.Diagnostics.Debug.WriteLine("Nidaq: Error while writing: " + e.Message);
+                SessionGraph.AsyncEmergencyStop(null);
+            } catch (TimeoutException e) {
                 System.Diagnostics.Debug.WriteLine("Nidaq: Error while writing: " + e.Message);
                 SessionGraph.AsyncEmergencyStop(null);
             }
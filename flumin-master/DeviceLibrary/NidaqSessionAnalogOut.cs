@@ -1,6 +1,7 @@
 ﻿using System;
 using System.Collections.Generic;
 using System.Linq;
+using System.Runtime.InteropServices;
 using System.Text;
 using System.Threading.Tasks;
 using System.Xml;
@@ -16,8 +17,8 @@ namespace DeviceLibrary {
         }
 
         private readonly List<MetricAnalogOutput> _nodes = new List<MetricAnalogOutput>();
-        private NationalInstruments.DAQmx.AnalogMultiChannelWriter _writer;
-        private NationalInstruments.DAQmx.Task _task;
+        private int _hPoll;
+        private int _prefillBuffers;
 
         public int ClockRate { get; set; }
         public int TaskHandle { get; private set; }
@@ -33,12 +34,9 @@ namespace DeviceLibrary {
         public IReadOnlyList<INidaqMetric> Nodes => _nodes;
 
         private double[,] _bufferData;
-        private double[,] _usableData;
+        private double[] _usableData;
         private int[] _channelCount;
 
-        private IAsyncResult _writeResult;
-        private bool _first;
-
         /// <summary>
         /// Write data to the device
         /// </summary>
@@ -47,7 +45,8 @@ namespace DeviceLibrary {
         /// <param name="offset"></param>
         /// <param name="size"></param>
         /// <returns>number of samples written</returns>
-        /// <exception cref="NationalInstruments.DAQmx.DaqException">Device error</exception>
+        /// <exception cref="NidaqException">Device error</exception>
+        /// <exception cref="TimeoutException">The device did not take the queued data in time</exception>
         public int Write(int channel, double[] data, int offset, int size) {
             // Exceptions should be dealt with outside, meaning in NidaqSession
 
@@ -65,53 +64,63 @@ namespace DeviceLibrary {
                 );
                 _channelCount[channel] += size;
 
-                // check if this will be the first write to the device.
-                // If so, the amount of data has to surpass the defined prebuffer size.
-                var prebufferSamples = (int)(PrebufferLengthMs * (long)ClockRate / 1000);
-                if (_first && !_channelCount.All(x => x >= (SamplesPerChannel + prebufferSamples))) return size;
-
                 if (_channelCount.All(x => x >= SamplesPerChannel)) {
-                    // enough data collected to write to the device.
-                    // Wait for the previous write.
-                    if (_writeResult != null) {
-                        _writeResult.AsyncWaitHandle.WaitOne();
-                        _writer.EndWrite(_writeResult);
-                    }
-
-                    // copy parts of local channel buffers to a buffer of the size specified in the initialization of the nidaq task
-                    for (int i = 0; i < _channelCount.Length; i++) {
-                        Buffer.BlockCopy(
-                            _bufferData,
-                            i * _bufferData.GetLength(1) * sizeof(double),
-                            _usableData,
-                            i * _usableData.GetLength(1) * sizeof(double),
-                            SamplesPerChannel * sizeof(double)
-                        );
-                    }
-
-                    // start asynchronous write to device
-                    _writeResult = _writer.BeginWriteMultiSample(true, _usableData, null, null);
-                    System.Diagnostics.Debug.WriteLine("Write new data to dev. Length: " + _usableData.GetLength(1));
+                    // enough data collected for one buffer of the native output loop.
+                    // It keeps writing the queued buffers while the graph is busy,
+                    // the prebuffer is queued before the loop starts the task
+                    SubmitBuffer();
 
                     // copy unwritten parts of local channel buffers to front of buffers
                     for (int i = 0; i < _channelCount.Length; i++) {
                         Buffer.BlockCopy(
-                            _bufferData,
-                            _bufferData.GetLength(1) * i * sizeof(double),
                             _bufferData,
                             (_bufferData.GetLength(1) * i + SamplesPerChannel) * sizeof(double),
+                            _bufferData,
+                            _bufferData.GetLength(1) * i * sizeof(double),
                             (_channelCount[i] - SamplesPerChannel) * sizeof(double)
                         );
                         _channelCount[i] -= SamplesPerChannel;
                     }
-
-                    _first = false;
                 }
             }
 
             return size;
         }
 
+        private void SubmitBuffer() {
+            NILoop.BufferLease lease;
+
+            // the loop is gone after Stop(). The next write after a restart brings it back
+            if (_hPoll == 0) StartLoop();
+
+            var result = NILoop.acquire_write_buffer(_hPoll, TaskHandle, out lease);
+            if (result == 2) {
+                // every buffer is queued. Wait for the loop to write one
+                if (NILoop.wait_buffer(_hPoll, TaskHandle, WriteTimeoutMs) != 0) {
+                    throw new TimeoutException("NILoop: no output buffer was written in time");
+                }
+                result = NILoop.acquire_write_buffer(_hPoll, TaskHandle, out lease);
+            }
+            if (result != 0) throw new NidaqException(result);
+
+            // copy parts of local channel buffers to a buffer of the size specified in the initialization of the nidaq task
+            for (int i = 0; i < _channelCount.Length; i++) {
+                Buffer.BlockCopy(
+                    _bufferData,
+                    i * _bufferData.GetLength(1) * sizeof(double),
+                    _usableData,
+                    i * SamplesPerChannel * sizeof(double),
+                    SamplesPerChannel * sizeof(double)
+                );
+            }
+
+            Marshal.Copy(_usableData, 0, lease.data, _usableData.Length);
+
+            // a negative result reports a write of an earlier buffer that failed
+            result = NILoop.submit_write_buffer(_hPoll, TaskHandle, lease.id, SamplesPerChannel);
+            if (result != 0) throw new NidaqException(result);
+        }
+
         /// <summary>
         /// Creates a new DAQmx task and adds channels to it
         /// </summary>
@@ -145,63 +154,77 @@ namespace DeviceLibrary {
 
             SamplesPerChannel = nidaqBufferSizePerChannel;
 
-            // ------------------------------
-            // Configure DAQMX Task
+            // buffers queued before the output starts. At least two, so the loop
+            // always has the next buffer ready while the device plays one
+            _prefillBuffers = Math.Max(2, (PrebufferLengthMs + BufferLengthMs - 1) / Math.Max(1, BufferLengthMs) + 1);
 
-            _task = new NationalInstruments.DAQmx.Task();
+            // 1. create task
+            var taskHandle = new int[1];
+            var result = NidaQmxHelper.DAQmxCreateTask(null, taskHandle);
+            if (result < 0) throw new NidaqException(result);
+            TaskHandle = taskHandle[0];
+
+            // 2. create channels
             foreach (var output in nodes.OfType<MetricAnalogOutput>()) {
                 output.ChannelNumber = _nodes.Count;
 
-                _task.AOChannels.CreateVoltageChannel(
-                    output.Channel.Path, 
-                    string.Empty, 
-                    output.VMin, 
-                    output.VMax, 
-                    NationalInstruments.DAQmx.AOVoltageUnits.Volts
+                result = NidaQmxHelper.DAQmxCreateAOVoltageChan(
+                    maxVal:                 output.VMax,
+                    minVal:                 output.VMin,
+                    units:                  NidaQmxHelper.DaQmxValVolts,
+                    physicalChannel:        output.Channel.Path,
+                    taskHandle:             TaskHandle,
+                    nameToAssignToChannel:  null,
+                    customScaleName:        null
                 );
+                if (result < 0) CleanupAndThrow(result);
 
                 _nodes.Add(output);
             }
 
-            _task.Timing.ConfigureSampleClock(
-                "", 
-                ClockRate, 
-                NationalInstruments.DAQmx.SampleClockActiveEdge.Rising, 
-                NationalInstruments.DAQmx.SampleQuantityMode.ContinuousSamples, 
-                SamplesPerChannel
+            // 3. configure clock and buffer
+            result = NidaQmxHelper.DAQmxCfgSampClkTiming(
+                activeEdge:                 NidaQmxHelper.DaQmxValRising,
+                sampleMode:                 NidaQmxHelper.DaQmxValContSamps,
+                sampsPerChan:               (ulong)SamplesPerChannel,
+                taskHandle:                 TaskHandle,
+                source:                     "",
+                rate:                       ClockRate
             );
+            if (result < 0) CleanupAndThrow(result);
 
-            try {
-                _task.Stream.ConfigureOutputBuffer(SamplesPerChannel);
-            } catch (NationalInstruments.DAQmx.DaqException e) {
-                throw new NidaqException(e.Error);
-            }
+            result = NidaQmxHelper.DAQmxCfgOutputBuffer(TaskHandle, (uint)(SamplesPerChannel * _prefillBuffers));
+            if (result < 0) CleanupAndThrow(result);
 
-            _task.Stream.Timeout = WriteTimeoutMs;
-            _task.Stream.WriteRegenerationMode = NationalInstruments.DAQmx.WriteRegenerationMode.DoNotAllowRegeneration;
+            result = NidaQmxHelper.DAQmxSetWriteRegenMode(TaskHandle, NidaQmxHelper.DAQmx_Val_DoNotAllowRegen);
+            if (result < 0) CleanupAndThrow(result);
 
+            // 4. hand the task to the native output loop. It starts the task
+            // itself once the prefill buffers are written
             try {
-                _task.Control(NationalInstruments.DAQmx.TaskAction.Verify);
-            } catch (NationalInstruments.DAQmx.DaqException e) {
-                throw new NidaqException(e.Error);
+                StartLoop();
+            } catch (OutOfMemoryException) {
+                NidaQmxHelper.DAQmxClearTask(TaskHandle);
+                TaskHandle = 0;
+                SamplesPerChannel = 0;
+                _nodes.Clear();
+                throw;
             }
 
-            _task.Stream.Buffer.OutputBufferSize = SamplesPerChannel;
-
-            _writer = new NationalInstruments.DAQmx.AnalogMultiChannelWriter(_task.Stream);
-
-            TaskHandle = _task.GetHashCode();
-
-            _usableData = new double[_nodes.Count, SamplesPerChannel];
+            _usableData = new double[_nodes.Count * SamplesPerChannel];
             _bufferData = new double[_nodes.Count, localBufferSizePerChannel];
             _channelCount = new int[_nodes.Count];
 
             State = SessionTaskState.Stopped;
-            _first = true;
         }
 
         public void DestroyTask() {
-            _task.Dispose();
+            StopLoop();
+
+            if (TaskHandle != 0) {
+                NidaQmxHelper.DAQmxClearTask(TaskHandle);
+            }
+
             TaskHandle = 0;
             SamplesPerChannel = 0;
             _nodes.Clear();
@@ -210,20 +233,23 @@ namespace DeviceLibrary {
 
         public void Start() {
             if (TaskHandle == 0) throw new InvalidOperationException("Task not yet created. First create a task");
-            _task.Start();
+            // Stop() tears the loop down. The native loop starts the DAQmx task once the prebuffer is queued
+            if (_hPoll == 0) StartLoop();
             State = SessionTaskState.Running;
         }
 
         public void Stop() {
             if (TaskHandle == 0) throw new InvalidOperationException("Task not yet created. First create a task");
-            _task.Stop();
+
+            StopLoop();
+
+            var result = NidaQmxHelper.DAQmxStopTask(TaskHandle);
+            if (result < 0) CleanupAndThrow(result, false);
 
             // clear old data
-            for (int i = 0; i < _nodes.Count; i++) {
-                for (int j = 0; j < _usableData.GetLength(1); j++) {
-                    _usableData[i, j] = 0;
-                }
+            Array.Clear(_usableData, 0, _usableData.Length);
 
+            for (int i = 0; i < _nodes.Count; i++) {
                 for (int j = 0; j < _bufferData.GetLength(1); j++) {
                     _bufferData[i, j] = 0;
                 }
@@ -234,6 +260,63 @@ namespace DeviceLibrary {
             State = SessionTaskState.Stopped;
         }
 
+        /// <summary>
+        /// Hands the configured task to a new native output loop
+        /// </summary>
+        /// <exception cref="OutOfMemoryException">The loop could not allocate its buffers</exception>
+        private void StartLoop() {
+            var info = new NILoop.HandleInfo {
+                handle           = TaskHandle,
+                samples_per_chan = SamplesPerChannel,
+                buffer_size      = SamplesPerChannel * _nodes.Count,
+                type             = (int)NILoop.TASK_TYPE.TASK_TYPE_ANALOG_OUTPUT,
+                flags            = (int)NILoop.TASK_FLAG.TASK_FLAG_SHARED_ARENA,
+                pool_depth       = _prefillBuffers + 2,
+                prefill_buffers  = _prefillBuffers,
+                thread_group     = NILoop.THREAD_GROUP_OWN,
+                thread_priority  = (int)NILoop.READER_PRIORITY.READER_PRIORITY_HIGH
+            };
+
+            _hPoll = NILoop.start_polling(new[] { info }, 1);
+            if (_hPoll == 0) {
+                throw new OutOfMemoryException("NILoop: could not allocate the output buffers");
+            }
+        }
+
+        private void StopLoop() {
+            if (_hPoll == 0) return;
+
+            NILoop.PoolStats stats;
+            if (NILoop.get_pool_stats(_hPoll, TaskHandle, out stats) == 0 && stats.underruns > 0) {
+                System.Diagnostics.Debug.WriteLine(
+                    $"NILoop: output task {TaskHandle} ran out of queued buffers {stats.underruns} times"
+                );
+            }
+
+            NILoop.stop_polling(_hPoll);
+            _hPoll = 0;
+        }
+
+        private void CleanupAndThrow(int code, bool doThrow = true) {
+            StopLoop();
+            NidaQmxHelper.DAQmxClearTask(TaskHandle);
+            TaskHandle = 0;
+            SamplesPerChannel = 0;
+            _nodes.Clear();
+            State = SessionTaskState.None;
+
+            if (doThrow) {
+                throw new NidaqException(code);
+            } else {
+                Parent.SessionGraph.Context.Notify(
+                    new NodeSystemLib2.Generic.GraphNotification(
+                        NodeSystemLib2.Generic.GraphNotification.NotificationType.Error, 
+                        NidaQmxHelper.GetError(code)
+                    )
+                );
+            }
+        }
+
         public void Serialize(XmlWriter writer) {
             writer.WriteStartElement("task");
             writer.WriteAttributeString("type", "ao");
@@ -1,6 +1,7 @@
 ﻿using System;
 using System.Collections.Generic;
 using System.Linq;
+using System.Runtime.InteropServices;
 using System.Text;
 using System.Threading.Tasks;
 using System.Xml;
@@ -16,8 +17,8 @@ namespace DeviceLibrary {
         }
 
         private readonly List<MetricDigitalOutput> _nodes = new List<MetricDigitalOutput>();
-        private NationalInstruments.DAQmx.DigitalMultiChannelWriter _writer;
-        private NationalInstruments.DAQmx.Task _task;
+        private int _hPoll;
+        private int _prefillBuffers;
 
         public string ClockPath { get; set; }
         public int ClockRate { get; set; }
@@ -34,12 +35,9 @@ namespace DeviceLibrary {
         public IReadOnlyList<INidaqMetric> Nodes => _nodes;
 
         private int[,] _bufferData;
-        private int[,] _usableData;
+        private int[] _usableData;
         private int[] _channelCount;
 
-        private IAsyncResult _writeResult;
-        private bool _first;
-
         /// <summary>
         /// Write data to the device
         /// </summary>
@@ -48,7 +46,8 @@ namespace DeviceLibrary {
         /// <param name="offset"></param>
         /// <param name="size"></param>
         /// <returns>number of samples written</returns>
-        /// <exception cref="NationalInstruments.DAQmx.DaqException">Device error</exception>
+        /// <exception cref="NidaqException">Device error</exception>
+        /// <exception cref="TimeoutException">The device did not take the queued data in time</exception>
         public int Write(int channel, double[] data, int offset, int size) {
             // Exceptions should be dealt with outside, meaning in NidaqSession
 
@@ -59,63 +58,74 @@ namespace DeviceLibrary {
                 // write as much of the data as possible to the local buffer
                 var sampleStart = _channelCount[channel];
                 for (int i = 0; i < size; i++) {
-                    _bufferData[channel, i + sampleStart] = data[i] > 0.5 ? 1 : 0;
+                    _bufferData[channel, i + sampleStart] = data[offset + i] > 0.5 ? 1 : 0;
                 }
-                //Buffer.BlockCopy(
-                //    data,
-                //    offset * sizeof(bool),
-                //    _bufferData,
-                //    (channel * _bufferData.GetLength(1) + _channelCount[channel]) * sizeof(bool),
-                //    size * sizeof(bool)
-                //);
                 _channelCount[channel] += size;
 
-                // check if this will be the first write to the device.
-                // If so, the amount of data has to surpass the defined prebuffer size.
-                var prebufferSamples = (int)(PrebufferLengthMs * (long)ClockRate / 1000);
-                if (_first && !_channelCount.All(x => x >= (SamplesPerChannel + prebufferSamples))) return size;
-
                 if (_channelCount.All(x => x >= SamplesPerChannel)) {
-                    // enough data collected to write to the device.
-                    // Wait for the previous write.
-                    if (_writeResult != null) {
-                        _writeResult.AsyncWaitHandle.WaitOne();
-                        _writer.EndWrite(_writeResult);
-                    }
-
-                    // copy parts of local channel buffers to a buffer of the size specified in the initialization of the nidaq task
-                    for (int i = 0; i < _channelCount.Length; i++) {
-                        Buffer.BlockCopy(
-                            _bufferData,
-                            i * _bufferData.GetLength(1) * sizeof(int),
-                            _usableData,
-                            i * _usableData.GetLength(1) * sizeof(int),
-                            SamplesPerChannel * sizeof(int)
-                        );
-                    }
-
-                    // start asynchronous write to device
-                    _writeResult = _writer.BeginWriteMultiSamplePort(true, _usableData, null, null);
+                    // enough data collected for one buffer of the native output loop.
+                    // It keeps writing the queued buffers while the graph is busy,
+                    // the prebuffer is queued before the loop starts the task
+                    SubmitBuffer();
 
                     // copy unwritten parts of local channel buffers to front of buffers
                     for (int i = 0; i < _channelCount.Length; i++) {
                         Buffer.BlockCopy(
-                            _bufferData,
-                            _bufferData.GetLength(1) * i * sizeof(int),
                             _bufferData,
                             (_bufferData.GetLength(1) * i + SamplesPerChannel) * sizeof(int),
+                            _bufferData,
+                            _bufferData.GetLength(1) * i * sizeof(int),
                             (_channelCount[i] - SamplesPerChannel) * sizeof(int)
                         );
                         _channelCount[i] -= SamplesPerChannel;
                     }
-
-                    _first = false;
                 }
             }
 
             return size;
         }
 
+        private void SubmitBuffer() {
+            NILoop.BufferLease lease;
+
+            // the loop is gone after Stop(). The next write after a restart brings it back
+            if (_hPoll == 0) StartLoop();
+
+            var result = NILoop.acquire_write_buffer(_hPoll, TaskHandle, out lease);
+            if (result == 2) {
+                // every buffer is queued. Wait for the loop to write one
+                if (NILoop.wait_buffer(_hPoll, TaskHandle, WriteTimeoutMs) != 0) {
+                    throw new TimeoutException("NILoop: no output buffer was written in time");
+                }
+                result = NILoop.acquire_write_buffer(_hPoll, TaskHandle, out lease);
+            }
+            if (result != 0) throw new NidaqException(result);
+
+            // copy parts of local channel buffers to a buffer of the size specified in the initialization of the nidaq task
+            for (int i = 0; i < _channelCount.Length; i++) {
+                Buffer.BlockCopy(
+                    _bufferData,
+                    i * _bufferData.GetLength(1) * sizeof(int),
+                    _usableData,
+                    i * SamplesPerChannel * sizeof(int),
+                    SamplesPerChannel * sizeof(int)
+                );
+            }
+
+            Marshal.Copy(_usableData, 0, lease.data, _usableData.Length);
+
+            // a negative result reports a write of an earlier buffer that failed
+            result = NILoop.submit_write_buffer(_hPoll, TaskHandle, lease.id, SamplesPerChannel);
+            if (result != 0) throw new NidaqException(result);
+        }
+
+        /// <summary>
+        /// Creates a new DAQmx task and adds channels to it
+        /// </summary>
+        /// <param name="nodes">Graph nodes of type MetricDigitalOutput</param>
+        /// <exception cref="InvalidCastException">At least one element in <paramref name="nodes"/> not of type MetricDigitalOutput</exception>
+        /// <exception cref="InvalidOperationException">At least one element in <paramref name="nodes"/> not connected to the instance's specified device</exception>
+        /// <exception cref="NidaqException">Task or channel could not be created</exception>
         public void CreateTask(IEnumerable<INidaqMetric> nodes) {
             if (!nodes.All(n => n is MetricDigitalOutput)) {
                 throw new InvalidCastException("all passed nodes must be of type MetricDigitalOutput");
@@ -142,61 +152,74 @@ namespace DeviceLibrary {
 
             SamplesPerChannel = nidaqBufferSizePerChannel;
 
-            // ------------------------------
-            // Configure DAQMX Task
+            // buffers queued before the output starts. At least two, so the loop
+            // always has the next buffer ready while the device plays one
+            _prefillBuffers = Math.Max(2, (PrebufferLengthMs + BufferLengthMs - 1) / Math.Max(1, BufferLengthMs) + 1);
+
+            // 1. create task
+            var taskHandle = new int[1];
+            var result = NidaQmxHelper.DAQmxCreateTask(null, taskHandle);
+            if (result < 0) throw new NidaqException(result);
+            TaskHandle = taskHandle[0];
 
-            _task = new NationalInstruments.DAQmx.Task();
+            // 2. create channels
             foreach (var output in nodes.OfType<MetricDigitalOutput>()) {
                 output.ChannelNumber = _nodes.Count;
 
-                _task.DOChannels.CreateChannel(
-                    output.Channel.Path,
-                    string.Empty,
-                    NationalInstruments.DAQmx.ChannelLineGrouping.OneChannelForEachLine
+                result = NidaQmxHelper.DAQmxCreateDOChan(
+                    taskHandle:             TaskHandle,
+                    lines:                  output.Channel.Path,
+                    nameToAssignToChannel:  null,
+                    lineGrouping:           NidaQmxHelper.DAQmx_Val_ChanPerLine
                 );
+                if (result < 0) CleanupAndThrow(result);
 
                 _nodes.Add(output);
             }
 
-            _task.Timing.ConfigureSampleClock(
-                ClockPath,
-                ClockRate,
-                NationalInstruments.DAQmx.SampleClockActiveEdge.Rising,
-                NationalInstruments.DAQmx.SampleQuantityMode.ContinuousSamples,
-                SamplesPerChannel
+            // 3. configure clock and buffer
+            result = NidaQmxHelper.DAQmxCfgSampClkTiming(
+                activeEdge:                 NidaQmxHelper.DaQmxValRising,
+                sampleMode:                 NidaQmxHelper.DaQmxValContSamps,
+                sampsPerChan:               (ulong)SamplesPerChannel,
+                taskHandle:                 TaskHandle,
+                source:                     ClockPath ?? "",
+                rate:                       ClockRate
             );
+            if (result < 0) CleanupAndThrow(result);
 
-            try {
-                _task.Stream.ConfigureOutputBuffer(SamplesPerChannel);
-            } catch (NationalInstruments.DAQmx.DaqException e) {
-                throw new NidaqException(e.Error);
-            }
+            result = NidaQmxHelper.DAQmxCfgOutputBuffer(TaskHandle, (uint)(SamplesPerChannel * _prefillBuffers));
+            if (result < 0) CleanupAndThrow(result);
 
-            _task.Stream.Timeout = WriteTimeoutMs;
-            _task.Stream.WriteRegenerationMode = NationalInstruments.DAQmx.WriteRegenerationMode.DoNotAllowRegeneration;
+            result = NidaQmxHelper.DAQmxSetWriteRegenMode(TaskHandle, NidaQmxHelper.DAQmx_Val_DoNotAllowRegen);
+            if (result < 0) CleanupAndThrow(result);
 
+            // 4. hand the task to the native output loop. It starts the task
+            // itself once the prefill buffers are written
             try {
-                _task.Control(NationalInstruments.DAQmx.TaskAction.Verify);
-            } catch (NationalInstruments.DAQmx.DaqException e) {
-                throw new NidaqException(e.Error);
+                StartLoop();
+            } catch (OutOfMemoryException) {
+                NidaQmxHelper.DAQmxClearTask(TaskHandle);
+                TaskHandle = 0;
+                SamplesPerChannel = 0;
+                _nodes.Clear();
+                throw;
             }
 
-            _task.Stream.Buffer.OutputBufferSize = SamplesPerChannel;
-
-            _writer = new NationalInstruments.DAQmx.DigitalMultiChannelWriter(_task.Stream);
-
-            TaskHandle = _task.GetHashCode();
-
-            _usableData = new int[_nodes.Count, SamplesPerChannel];
+            _usableData = new int[_nodes.Count * SamplesPerChannel];
             _bufferData = new int[_nodes.Count, localBufferSizePerChannel];
             _channelCount = new int[_nodes.Count];
 
             State = SessionTaskState.Stopped;
-            _first = true;
         }
 
         public void DestroyTask() {
-            _task.Dispose();
+            StopLoop();
+
+            if (TaskHandle != 0) {
+                NidaQmxHelper.DAQmxClearTask(TaskHandle);
+            }
+
             TaskHandle = 0;
             SamplesPerChannel = 0;
             _nodes.Clear();
@@ -205,16 +228,84 @@ namespace DeviceLibrary {
 
         public void Start() {
             if (TaskHandle == 0) throw new InvalidOperationException("Task not yet created. First create a task");
-            _task.Start();
+            // Stop() tears the loop down. The native loop starts the DAQmx task once the prebuffer is queued
+            if (_hPoll == 0) StartLoop();
             State = SessionTaskState.Running;
         }
 
         public void Stop() {
             if (TaskHandle == 0) throw new InvalidOperationException("Task not yet created. First create a task");
-            _task.Stop();
+
+            StopLoop();
+
+            var result = NidaQmxHelper.DAQmxStopTask(TaskHandle);
+            if (result < 0) CleanupAndThrow(result, false);
+
+            // clear old data
+            Array.Clear(_usableData, 0, _usableData.Length);
+            Array.Clear(_bufferData, 0, _bufferData.Length);
+            Array.Clear(_channelCount, 0, _channelCount.Length);
+
             State = SessionTaskState.Stopped;
         }
 
+        /// <summary>
+        /// Hands the configured task to a new native output loop
+        /// </summary>
+        /// <exception cref="OutOfMemoryException">The loop could not allocate its buffers</exception>
+        private void StartLoop() {
+            var info = new NILoop.HandleInfo {
+                handle           = TaskHandle,
+                samples_per_chan = SamplesPerChannel,
+                buffer_size      = SamplesPerChannel * _nodes.Count,
+                type             = (int)NILoop.TASK_TYPE.TASK_TYPE_DIGITAL_OUTPUT,
+                flags            = (int)NILoop.TASK_FLAG.TASK_FLAG_SHARED_ARENA,
+                pool_depth       = _prefillBuffers + 2,
+                prefill_buffers  = _prefillBuffers,
+                thread_group     = NILoop.THREAD_GROUP_OWN,
+                thread_priority  = (int)NILoop.READER_PRIORITY.READER_PRIORITY_HIGH
+            };
+
+            _hPoll = NILoop.start_polling(new[] { info }, 1);
+            if (_hPoll == 0) {
+                throw new OutOfMemoryException("NILoop: could not allocate the output buffers");
+            }
+        }
+
+        private void StopLoop() {
+            if (_hPoll == 0) return;
+
+            NILoop.PoolStats stats;
+            if (NILoop.get_pool_stats(_hPoll, TaskHandle, out stats) == 0 && stats.underruns > 0) {
+                System.Diagnostics.Debug.WriteLine(
+                    $"NILoop: output task {TaskHandle} ran out of queued buffers {stats.underruns} times"
+                );
+            }
+
+            NILoop.stop_polling(_hPoll);
+            _hPoll = 0;
+        }
+
+        private void CleanupAndThrow(int code, bool doThrow = true) {
+            StopLoop();
+            NidaQmxHelper.DAQmxClearTask(TaskHandle);
+            TaskHandle = 0;
+            SamplesPerChannel = 0;
+            _nodes.Clear();
+            State = SessionTaskState.None;
+
+            if (doThrow) {
+                throw new NidaqException(code);
+            } else {
+                Parent.SessionGraph.Context.Notify(
+                    new NodeSystemLib2.Generic.GraphNotification(
+                        NodeSystemLib2.Generic.GraphNotification.NotificationType.Error, 
+                        NidaQmxHelper.GetError(code)
+                    )
+                );
+            }
+        }
+
         public void LoadFactorySettings() {
             if (!NidaqSingleton.Instance.FactorySettings.ContainsKey(Parent.SessionGraph)) return;
             var factorySettings = NidaqSingleton.Instance.FactorySettings[Parent.SessionGraph];
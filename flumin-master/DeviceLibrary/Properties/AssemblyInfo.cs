@@ -19,6 +19,8 @@ using System.Runtime.InteropServices;
 // COM, set the ComVisible attribute to true on that type.
 [assembly: ComVisible(false)]
 
+[assembly: InternalsVisibleTo("SimpleADCTest")]
+
 // The following GUID is for the ID of the typelib if this project is exposed to COM
 [assembly: Guid("907710ac-05fb-46e5-8e40-09ec32ec8973")]
 
@@ -33,6 +33,12 @@ namespace FluPy {
             NPY_CHAR
         }
 
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        public delegate void BufferRelease(IntPtr cookie);
+
+        // kept in a static field so the delegate outlives every array still pinning a buffer
+        private static readonly BufferRelease ReleasePinned = cookie => GCHandle.FromIntPtr(cookie).Free();
+
         private PyObject _pyObject;
 
         public PyArray(int[] values, bool manageRef = true) {
@@ -52,6 +58,66 @@ namespace FluPy {
             _pyObject = pyObj;
         }
 
+        /// <summary>
+        /// Creates an array that views the first count elements of values without copying them.
+        /// The managed array stays pinned until python drops the last reference to the view.
+        /// </summary>
+        public static PyArray Wrap(double[] values, int count, bool writable, bool manageRef = true) {
+            return Wrap(values, 0, count, Type.NPY_DOUBLE, writable, manageRef);
+        }
+
+        public static PyArray Wrap(int[] values, int count, bool writable, bool manageRef = true) {
+            return Wrap(values, 0, count, Type.NPY_INT, writable, manageRef);
+        }
+
+        public static PyArray Wrap(float[] values, int count, bool writable, bool manageRef = true) {
+            return Wrap(values, 0, count, Type.NPY_FLOAT, writable, manageRef);
+        }
+
+        /// <summary>
+        /// Creates an array that views count elements of values starting at offset without copying them.
+        /// </summary>
+        public static PyArray Wrap(double[] values, int offset, int count, bool writable, bool manageRef = true) {
+            return Wrap(values, offset, count, Type.NPY_DOUBLE, writable, manageRef);
+        }
+
+        private static PyArray Wrap(Array values, int offset, int count, Type type, bool writable, bool manageRef) {
+            if (offset < 0 || offset > values.Length) throw new ArgumentOutOfRangeException(nameof(offset));
+            if (count < 0 || count > values.Length - offset) throw new ArgumentOutOfRangeException(nameof(count));
+
+            var handle = GCHandle.Alloc(values, GCHandleType.Pinned);
+            var data = offset < values.Length
+                ? Marshal.UnsafeAddrOfPinnedArrayElement(values, offset)
+                : handle.AddrOfPinnedObject();
+            var cookie = GCHandle.ToIntPtr(handle);
+
+            // the handle is freed by the release callback, also when wrapping fails
+            var obj = writable
+                ? PyArray_Wrap(data, new IntPtr(count), type, ReleasePinned, cookie)
+                : PyArray_WrapReadOnly(data, new IntPtr(count), type, ReleasePinned, cookie);
+
+            return FromWrapped(obj, manageRef);
+        }
+
+        /// <summary>
+        /// Creates an array that views native memory without copying it. release is called with
+        /// cookie once the last view is gone and must stay alive until then.
+        /// </summary>
+        public static PyArray Wrap(IntPtr data, int count, Type type, bool writable, BufferRelease release, IntPtr cookie, bool manageRef = true) {
+            var obj = writable
+                ? PyArray_Wrap(data, new IntPtr(count), type, release, cookie)
+                : PyArray_WrapReadOnly(data, new IntPtr(count), type, release, cookie);
+
+            return FromWrapped(obj, manageRef);
+        }
+
+        private static PyArray FromWrapped(IntPtr obj, bool manageRef) {
+            if (obj == IntPtr.Zero) {
+                throw new PyException("Could not create array view", -1, -1);
+            }
+            return new PyArray(new PyObject(obj, manageRef));
+        }
+
         public int Length => PyArray_GetSize(_pyObject.Handle);
 
         public PyObject Object => _pyObject;
@@ -0,0 +1,44 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using static FluPy.PyDll;
+
+namespace FluPy {
+
+    /// <summary>
+    /// Reusable arrays for data handed to python over and over, e.g. the samples of one port.
+    /// An array is only reused once python dropped every reference to it, so a script that
+    /// keeps an array never sees it change. Only a few arrays are kept, a script holding on to
+    /// all of them gets arrays the pool doesn't track. Must be used and disposed while holding the GIL.
+    /// </summary>
+    public class PyArrayPool : IDisposable {
+
+        private IntPtr _pool;
+
+        public PyArrayPool(int capacity, PyArray.Type type = PyArray.Type.NPY_DOUBLE) {
+            _pool = CreateArrayPool(capacity, type);
+        }
+
+        /// <summary>
+        /// Copies the first count values into an array of the pool and returns a new reference to it.
+        /// </summary>
+        public IntPtr Take(double[] values, int count) {
+            var array = ArrayPoolTake(_pool, values, count);
+            if (array == IntPtr.Zero) {
+                throw new PyException("Could not create array", -1, -1);
+            }
+            return array;
+        }
+
+        public void Dispose() {
+            if (_pool != IntPtr.Zero) {
+                ReleaseArrayPool(_pool);
+                _pool = IntPtr.Zero;
+            }
+        }
+
+    }
+
+}
@@ -0,0 +1,64 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using static FluPy.PyDll;
+
+namespace FluPy {
+
+    /// <summary>
+    /// A function of a context that is resolved once and can then be called repeatedly
+    /// without looking it up or marshalling an argument array again.
+    /// </summary>
+    public class PyCall : IDisposable {
+
+        private readonly PyContext _context;
+        private IntPtr _call;
+
+        internal PyCall(PyContext context, IntPtr call, int argc) {
+            _context = context;
+            _call = call;
+            ArgumentCount = argc;
+        }
+
+        public int ArgumentCount { get; }
+
+        /// <summary>
+        /// Sets an argument for all following calls. The call holds its own reference.
+        /// </summary>
+        public void SetArgument(int index, PyObject arg) {
+            if (SetCallArg(_call, index, arg?.Handle ?? IntPtr.Zero) == 0) {
+                throw new ArgumentOutOfRangeException(nameof(index));
+            }
+        }
+
+        public PyObject Invoke() {
+            var result = InvokeCall(_call);
+            if (result == IntPtr.Zero) {
+                throw _context.FetchException();
+            }
+            return new PyObject(result);
+        }
+
+        /// <summary>
+        /// Calls the function and drops its return value.
+        /// </summary>
+        public void Run() {
+            var result = InvokeCall(_call);
+            if (result == IntPtr.Zero) {
+                throw _context.FetchException();
+            }
+            DecRef(result);
+        }
+
+        public void Dispose() {
+            if (_call != IntPtr.Zero) {
+                ReleaseCall(_call);
+                _call = IntPtr.Zero;
+            }
+        }
+
+    }
+
+}
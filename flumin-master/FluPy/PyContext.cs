@@ -52,15 +52,65 @@ namespace FluPy {
             var result = new PyObject(CallFunc(_context, code.Handle, argArray, argArray.Length));
 
             if (HasError(_context)) {
-                var errorMsg = StringFromNativeUtf8(GetError(_context));
-                var line = GetErrorLine(_context);
-                var offset = GetErrorOffset(_context);
-                throw new PyException(errorMsg, line, offset);
+                throw FetchException();
             }
 
             return result;
         }
 
+        /// <summary>
+        /// Looks up func once for repeated calls with argc arguments.
+        /// </summary>
+        public PyCall Prepare(string func, int argc) {
+            var call = PrepareCall(_context, func, argc);
+            if (call == IntPtr.Zero) {
+                if (HasError(_context)) throw FetchException();
+                throw new EntryPointNotFoundException("Function not found: " + func);
+            }
+            return new PyCall(this, call, argc);
+        }
+
+        /// <summary>
+        /// Calls, time and array allocations of the prepared calls since the last reset.
+        /// </summary>
+        public ContextStats Stats {
+            get {
+                ContextStats stats;
+                GetContextStats(_context, out stats);
+                return stats;
+            }
+        }
+
+        public void ResetStats() {
+            ResetContextStats(_context);
+        }
+
+        /// <summary>
+        /// Samples the running script line every intervalMicroseconds while prepared calls run,
+        /// 0 turns it off. Must not be changed during a call.
+        /// </summary>
+        public void SetLineProfiling(int intervalMicroseconds) {
+            PyDll.SetLineProfiling(_context, intervalMicroseconds);
+        }
+
+        /// <summary>
+        /// The most sampled lines of the script, the most sampled first.
+        /// </summary>
+        public IReadOnlyList<PyLineSamples> GetHotLines(int count) {
+            var lines = new int[count];
+            var samples = new long[count];
+            var found = PyDll.GetHotLines(_context, lines, samples, count);
+
+            return Enumerable.Range(0, found).Select(i => new PyLineSamples(lines[i], samples[i])).ToList();
+        }
+
+        internal PyException FetchException() {
+            var errorMsg = StringFromNativeUtf8(GetError(_context));
+            var line = GetErrorLine(_context);
+            var offset = GetErrorOffset(_context);
+            return new PyException(errorMsg, line, offset);
+        }
+
         public static PyContext FromCode(string code) {
             return FromCode(code, new PyModule[0]);
         }
@@ -76,6 +126,7 @@ namespace FluPy {
                 var errorMsg = StringFromNativeUtf8(GetError(context));
                 var line = GetErrorLine(context);
                 var offset = GetErrorOffset(context);
+                ReleaseContext(context);
                 throw new PyException(errorMsg, line, offset);
             }
 
@@ -91,8 +142,14 @@ namespace FluPy {
             return Encoding.UTF8.GetString(buffer);
         }
 
+        /// <summary>
+        /// Frees the globals of the script. Has to be called with the GIL held.
+        /// </summary>
         public void Dispose() {
-            //
+            if (_context != IntPtr.Zero) {
+                PyDll.ReleaseContext(_context);
+                _context = IntPtr.Zero;
+            }
         }
     }
 }
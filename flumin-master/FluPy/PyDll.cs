@@ -214,6 +214,21 @@ namespace FluPy {
         [DllImport(PythonDll, CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr Py_InitModule([MarshalAs(UnmanagedType.LPStr)]string name, [MarshalAs(UnmanagedType.LPArray)]PyMethodDef[] defs);
 
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void ReleaseMainThread();
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int AcquireGil();
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void ReleaseGil(int state);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr SaveThread();
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void RestoreThread(IntPtr state);
+
         [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr IncRef(IntPtr obj);
 
@@ -232,9 +247,39 @@ namespace FluPy {
         [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr CallFunc(IntPtr context, IntPtr func, [MarshalAs(UnmanagedType.LPArray)]IntPtr[] args, int argc);
 
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr PrepareCall(IntPtr context, [MarshalAs(UnmanagedType.LPStr)]string name, int argc);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int SetCallArg(IntPtr call, int index, IntPtr arg);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr InvokeCall(IntPtr call);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void ReleaseCall(IntPtr call);
+
         [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
         public static extern bool HasError(IntPtr context);
 
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void GetContextStats(IntPtr context, out ContextStats stats);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void ResetContextStats(IntPtr context);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void SetLineProfiling(IntPtr context, int intervalMicroseconds);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int GetHotLines(IntPtr context, [Out] int[] lines, [Out] long[] samples, int count);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long MarshalBegin();
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void MarshalEnd(long start);
+
         [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr GetLocalsFromContext(IntPtr context);
 
@@ -247,6 +292,9 @@ namespace FluPy {
         [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr CompileCode([MarshalAs(UnmanagedType.LPArray)] byte[] code, [MarshalAs(UnmanagedType.LPArray)] IntPtr[] modules, int moduleCount);
 
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void ReleaseContext(IntPtr context);
+
         [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
         public static extern int PyTuple_GetSize(IntPtr obj);
 
@@ -262,12 +310,100 @@ namespace FluPy {
         [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr PyArray_CreateEmpty(int count, PyArray.Type type);
 
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr PyArray_Wrap(IntPtr data, IntPtr count, PyArray.Type type, PyArray.BufferRelease release, IntPtr cookie);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr PyArray_WrapReadOnly(IntPtr data, IntPtr count, PyArray.Type type, PyArray.BufferRelease release, IntPtr cookie);
+
         [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr PyArray_GetPointer(IntPtr obj);
 
         [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
         public static extern int PyArray_GetSize(IntPtr obj);
 
+        [DllImport(WrapDll, EntryPoint = "PyArray_AsContiguous", CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr PyArray_AsContiguous(IntPtr obj, PyArray.Type type);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr CreateArrayPool(int capacity, PyArray.Type type);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr ArrayPoolTake(IntPtr pool, [MarshalAs(UnmanagedType.LPArray)]double[] values, int count);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void ReleaseArrayPool(IntPtr pool);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr WorkerAcquire([MarshalAs(UnmanagedType.LPWStr)]string pythonHome);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void WorkerRelease(IntPtr worker);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerIsDead(IntPtr worker);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerLoad(IntPtr worker, [MarshalAs(UnmanagedType.LPArray)]byte[] code, int size, uint timeout);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerInit(IntPtr worker, uint timeout);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerGetPortCount(IntPtr worker, int output);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr WorkerGetPortName(IntPtr worker, int output, int index);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerGetPortKind(IntPtr worker, int output, int index);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerGetSamplerate(IntPtr worker, int output, int index);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerSetPort(IntPtr worker, int output, int index, int samplerate, int capacity, int readLimit);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerPrepare(IntPtr worker, uint timeout);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerLayoutRings(IntPtr worker);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerProcess(IntPtr worker, uint timeout);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerFree(IntPtr worker, int index);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerWrite(IntPtr worker, int index, [MarshalAs(UnmanagedType.LPArray)]double[] src, int count);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerAvailable(IntPtr worker, int index);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerRead(IntPtr worker, int index, [MarshalAs(UnmanagedType.LPArray)]double[] dst, int count);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr WorkerGetError(IntPtr worker);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerGetErrorLine(IntPtr worker);
+
+        [DllImport(WrapDll, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int WorkerGetErrorOffset(IntPtr worker);
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct ContextStats {
+            public long Calls;
+            public double WallSeconds;
+            public double CpuSeconds;
+            public double MarshalSeconds;
+            public long ArrayBytes;
+            public long ArrayCount;
+        }
+
         [StructLayout(LayoutKind.Sequential)]
         public struct PyMethodDef {
             [MarshalAs(UnmanagedType.SysInt)]
@@ -285,12 +421,26 @@ namespace FluPy {
         public const int METH_VARARGS  = 0x0001;
         public const int METH_KEYWORDS = 0x0002;
 
+        private static readonly object InitLock = new object();
+        private static bool _initialized;
+
+        /// <summary>
+        /// Starts the interpreter once per process. Afterwards no thread holds the GIL,
+        /// callers take it through PyGil.
+        /// </summary>
         public static void Initialize(string pythonPath) {
-            var ptrPath = Marshal.StringToHGlobalUni(pythonPath);
-            Py_SetPythonHome(ptrPath);
-            Py_InitializeEx(1);
-            PyImport_ImportModule("numpy");
-            init_numpy();
+            lock (InitLock) {
+                if (_initialized) return;
+
+                var ptrPath = Marshal.StringToHGlobalUni(pythonPath);
+                Py_SetPythonHome(ptrPath);
+                Py_InitializeEx(1);
+                PyImport_ImportModule("numpy");
+                init_numpy();
+                ReleaseMainThread();
+
+                _initialized = true;
+            }
         }
 
     }
@@ -0,0 +1,54 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using static FluPy.PyDll;
+
+namespace FluPy {
+
+    /// <summary>
+    /// Holds the GIL of the calling thread until disposed. Can be nested and has to
+    /// wrap every use of python objects outside of python callbacks.
+    /// </summary>
+    public struct PyGil : IDisposable {
+
+        private readonly int _state;
+
+        private PyGil(int state) {
+            _state = state;
+        }
+
+        public static PyGil Acquire() {
+            return new PyGil(AcquireGil());
+        }
+
+        public void Dispose() {
+            ReleaseGil(_state);
+        }
+
+    }
+
+    /// <summary>
+    /// Gives up the GIL held by the calling thread until disposed, so other threads
+    /// can run python meanwhile. No python object may be touched inside.
+    /// </summary>
+    public struct PyAllowThreads : IDisposable {
+
+        private readonly IntPtr _threadState;
+
+        private PyAllowThreads(IntPtr threadState) {
+            _threadState = threadState;
+        }
+
+        public static PyAllowThreads Begin() {
+            return new PyAllowThreads(SaveThread());
+        }
+
+        public void Dispose() {
+            RestoreThread(_threadState);
+        }
+
+    }
+
+}
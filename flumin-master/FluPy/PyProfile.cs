@@ -0,0 +1,45 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using static FluPy.PyDll;
+
+namespace FluPy {
+
+    /// <summary>
+    /// Adds the time until disposed to the marshalling time of the context whose
+    /// prepared call runs on the calling thread.
+    /// </summary>
+    public struct PyMarshal : IDisposable {
+
+        private readonly long _start;
+
+        private PyMarshal(long start) {
+            _start = start;
+        }
+
+        public static PyMarshal Begin() {
+            return new PyMarshal(MarshalBegin());
+        }
+
+        public void Dispose() {
+            MarshalEnd(_start);
+        }
+
+    }
+
+    public struct PyLineSamples {
+
+        public PyLineSamples(int line, long samples) {
+            Line = line;
+            Samples = samples;
+        }
+
+        public int Line { get; }
+
+        public long Samples { get; }
+
+    }
+
+}
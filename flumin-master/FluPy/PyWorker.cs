@@ -0,0 +1,165 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Runtime.InteropServices;
+using System.Text;
+using System.Threading.Tasks;
+using static FluPy.PyDll;
+
+namespace FluPy {
+
+    /// <summary>
+    /// A python script running in a worker process started by PythonWrap. Port data is
+    /// exchanged through rings in shared memory, so a crashing or hanging script can't take
+    /// the host down and scripts of different nodes don't share a GIL.
+    /// </summary>
+    public class PyWorker : IDisposable {
+
+        public enum Status {
+            Ok,
+            PythonError,
+            Timeout,
+            Died,
+            Invalid
+        }
+
+        public enum PortKind {
+            Data,
+            Value
+        }
+
+        public struct PortDef {
+            public string Name;
+            public PortKind Kind;
+        }
+
+        private IntPtr _worker;
+
+        private PyWorker(IntPtr worker) {
+            _worker = worker;
+        }
+
+        /// <summary>
+        /// Takes an idle worker from the pool or starts a new one
+        /// </summary>
+        /// <exception cref="PyException">the worker process could not be started</exception>
+        public static PyWorker Acquire(string pythonHome) {
+            var worker = WorkerAcquire(pythonHome);
+            if (worker == IntPtr.Zero) {
+                throw new PyException("Could not start python worker process", -1, -1);
+            }
+            return new PyWorker(worker);
+        }
+
+        /// <summary>
+        /// Milliseconds a call may take before the worker is considered hung and killed
+        /// </summary>
+        public uint Timeout { get; set; } = 10000;
+
+        /// <summary>
+        /// The worker crashed or was killed. It has to be replaced by a new one.
+        /// </summary>
+        public bool IsDead => WorkerIsDead(_worker) != 0;
+
+        public IReadOnlyList<PortDef> Inputs => GetPorts(0);
+
+        public IReadOnlyList<PortDef> Outputs => GetPorts(1);
+
+        public void Load(string code) {
+            var utfCodeBytes = Encoding.UTF8.GetBytes("# -*- coding: utf-8 -*-\r\n" + code);
+            Check(WorkerLoad(_worker, utfCodeBytes, utfCodeBytes.Length, Timeout));
+        }
+
+        /// <summary>
+        /// Runs init of the script. Afterwards <see cref="Inputs"/> and <see cref="Outputs"/> hold its port definitions.
+        /// </summary>
+        public void Init() {
+            Check(WorkerInit(_worker, Timeout));
+        }
+
+        /// <summary>
+        /// Sets the samplerate and ring size of a port. ReadDataPort of an input returns at most readLimit samples.
+        /// </summary>
+        public void SetPort(bool output, int index, int samplerate, int capacity, int readLimit) {
+            Check(WorkerSetPort(_worker, output ? 1 : 0, index, samplerate, capacity, readLimit));
+        }
+
+        public int GetSamplerate(bool output, int index) {
+            return WorkerGetSamplerate(_worker, output ? 1 : 0, index);
+        }
+
+        /// <summary>
+        /// Runs prepare of the script. Input ports have to be set before, outputs afterwards
+        /// followed by <see cref="LayoutRings"/>.
+        /// </summary>
+        public void Prepare() {
+            Check(WorkerPrepare(_worker, Timeout));
+        }
+
+        public void LayoutRings() {
+            Check(WorkerLayoutRings(_worker));
+        }
+
+        public void Process() {
+            Check(WorkerProcess(_worker, Timeout));
+        }
+
+        public int Free(int input) => WorkerFree(_worker, input);
+
+        public int Write(int input, double[] data, int count) {
+            if (count < 0 || count > data.Length) throw new ArgumentOutOfRangeException(nameof(count));
+            return WorkerWrite(_worker, input, data, count);
+        }
+
+        public int Available(int output) => WorkerAvailable(_worker, output);
+
+        public int Read(int output, double[] data, int count) {
+            if (count < 0 || count > data.Length) throw new ArgumentOutOfRangeException(nameof(count));
+            return WorkerRead(_worker, output, data, count);
+        }
+
+        private IReadOnlyList<PortDef> GetPorts(int output) {
+            var count = WorkerGetPortCount(_worker, output);
+            var ports = new List<PortDef>(count);
+
+            for (int i = 0; i < count; i++) {
+                ports.Add(new PortDef {
+                    Name = StringFromNativeUtf8(WorkerGetPortName(_worker, output, i)),
+                    Kind = (PortKind)WorkerGetPortKind(_worker, output, i)
+                });
+            }
+
+            return ports;
+        }
+
+        private void Check(int status) {
+            if (status == (int)Status.Ok) return;
+
+            var errorMsg = StringFromNativeUtf8(WorkerGetError(_worker));
+            var line = WorkerGetErrorLine(_worker);
+            var offset = WorkerGetErrorOffset(_worker);
+            throw new PyException(errorMsg, line, offset);
+        }
+
+        // http://stackoverflow.com/a/10773988
+        private static string StringFromNativeUtf8(IntPtr nativeUtf8) {
+            int len = 0;
+            while (Marshal.ReadByte(nativeUtf8, len) != 0) ++len;
+            byte[] buffer = new byte[len];
+            Marshal.Copy(nativeUtf8, buffer, 0, buffer.Length);
+            return Encoding.UTF8.GetString(buffer);
+        }
+
+        /// <summary>
+        /// Ends the worker process. The pool starts a fresh one in its place, scripts never share a worker
+        /// </summary>
+        public void Dispose() {
+            if (_worker != IntPtr.Zero) {
+                WorkerRelease(_worker);
+                _worker = IntPtr.Zero;
+            }
+        }
+
+    }
+
+}
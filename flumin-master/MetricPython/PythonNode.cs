@@ -17,15 +17,33 @@ namespace MetricPython {
     [Metric("Python Script", "Other")]
     public class MetricPython : StateNode<MetricPython>, INodeUi {
 
+        public enum ExecutionMode {
+            InProcess,
+            Worker
+        }
+
         private const string PythonDir = @"C:\python35";
 
         private string _code = "";
         private PyContext _ctx;
+        private PyCall _process;
         private Editor _editor;
 
+        // arrays handed out by ReadDataPort, created on the first read of a port
+        private readonly Dictionary<NodeSystemLib2.FormatData1D.InputPortData1D, PyArrayPool> _readPools =
+            new Dictionary<NodeSystemLib2.FormatData1D.InputPortData1D, PyArrayPool>();
+
+        private PyWorker _worker;
+        private NodeSystemLib2.FormatData1D.InputPortData1D[] _workerInputs;
+        private NodeSystemLib2.FormatData1D.OutputPortData1D[] _workerOutputs;
+        private double[] _workerScratch;
+
         private readonly Dictionary<string, PyModule.PyCFunction> _moduleDef;
+        private readonly AttributeValueEnum<ExecutionMode> _attrExecution;
+        private readonly AttributeValueInt _attrLineProfiling;
 
         public MetricPython(XmlNode node, Graph g) : this(g) {
+            Deserializing(node);
             _code = node?.Attributes?.GetNamedItem("code")?.Value ?? "";
             if (!string.IsNullOrWhiteSpace(_code)) {
                 ReloadCode();
@@ -44,10 +62,23 @@ namespace MetricPython {
                 { "GetSamplerate", GetSamplerate },
                 { "SetSamplerate", SetSamplerate },
                 { "ReadDataPort", ReadDataPort },
-                { "WriteDataPort", WriteDataPort }
+                { "WriteDataPort", WriteDataPort },
+                { "ReadDataView", ReadDataView },
+                { "ConsumeData", ConsumeData },
+                { "WriteDataView", WriteDataView },
+                { "CommitData", CommitData }
             };
+
+            // Worker runs the script in a separate process. Only GetSamplerate, SetSamplerate,
+            // ReadDataPort and WriteDataPort are available to it there
+            _attrExecution = new AttributeValueEnum<ExecutionMode>(this, "Execution");
+
+            // sampling interval of the line profiler, 0 turns it off
+            _attrLineProfiling = new AttributeValueInt(this, "Line Profiling", "us", 0);
         }
 
+        private bool RunsInWorker => _attrExecution.TypedGet() == ExecutionMode.Worker;
+
         public override bool CanProcess => InputPorts.OfType<NodeSystemLib2.FormatData1D.InputPortData1D>().Any(port => port.Available > 0);
         public override bool CanTransfer => OutputPorts.OfType<NodeSystemLib2.FormatData1D.OutputPortData1D>().Any(port => port.Buffer.Available > 0);
 
@@ -56,12 +87,32 @@ namespace MetricPython {
                 _editor.AskForSave();
             }
 
-            if (_ctx == null) {
+            // a crashed worker or a changed execution mode needs the script loaded again
+            if (RunsInWorker != (_worker != null) || (_worker?.IsDead ?? false)) {
+                ReloadCode();
+            }
+
+            if (_ctx == null && _worker == null) {
                 throw new Exception("Python code has errors");
             }
 
             try {
-                _ctx.Call("prepare", new PyObject[0]);
+                if (_worker != null) {
+                    PrepareWorker();
+                } else {
+                    using (PyGil.Acquire()) {
+                        // the buffer capacities of the ports may change with the samplerates
+                        ReleaseReadPools();
+
+                        _ctx.Call("prepare", new PyObject[0]);
+
+                        _process?.Dispose();
+                        _process = _ctx.Prepare("process", 0);
+
+                        _ctx.SetLineProfiling(Math.Max(0, _attrLineProfiling.TypedGet()));
+                        _ctx.ResetStats();
+                    }
+                }
             }
             catch (PyException e) {
                 DisplayPythonError(e);
@@ -79,7 +130,13 @@ namespace MetricPython {
 
         public override void Process() {
             try {
-                _ctx?.Call("process", new PyObject[0]);
+                if (_worker != null) {
+                    ProcessWorker();
+                } else {
+                    using (PyGil.Acquire()) {
+                        _process?.Run();
+                    }
+                }
             }
             catch (PyException e) {
                 DisplayPythonError(e);
@@ -97,11 +154,123 @@ namespace MetricPython {
             if (_editor != null && !_editor.IsDisposed) {
                 _editor.EditorEnabled = true;
             }
+
+            if (_ctx != null && _worker == null) {
+                ReportStats();
+            }
+        }
+
+        private void ReportStats() {
+            PyDll.ContextStats stats;
+            IReadOnlyList<PyLineSamples> hotLines;
+
+            using (PyGil.Acquire()) {
+                stats = _ctx.Stats;
+                hotLines = _ctx.GetHotLines(5);
+            }
+
+            if (stats.Calls == 0) return;
+
+            var message = $"Python: {stats.Calls} calls of process, " +
+                          $"wall {stats.WallSeconds * 1000:0.###} ms, cpu {stats.CpuSeconds * 1000:0.###} ms, " +
+                          $"marshalling {stats.MarshalSeconds * 1000:0.###} ms, " +
+                          $"{stats.ArrayCount} arrays with {stats.ArrayBytes} bytes allocated";
+
+            if (hotLines.Count > 0) {
+                message += ", hottest lines: " + string.Join(", ", hotLines.Select(l => $"{l.Line} ({l.Samples})"));
+            }
+
+            Parent.Context.Notify(new GraphNotification(this, GraphNotification.NotificationType.Info, message));
         }
 
         public override void SuspendProcessing() {
         }
 
+        public override void Dispose() {
+            if (_readPools.Count > 0 || _process != null || _ctx != null) {
+                using (PyGil.Acquire()) {
+                    ReleaseReadPools();
+                    _process?.Dispose();
+                    _process = null;
+                    _ctx?.Dispose();
+                    _ctx = null;
+                }
+            }
+
+            _worker?.Dispose();
+            _worker = null;
+            base.Dispose();
+        }
+
+        private void PrepareWorker() {
+            var inputs = _worker.Inputs;
+            _workerInputs = new NodeSystemLib2.FormatData1D.InputPortData1D[inputs.Count];
+
+            for (int i = 0; i < inputs.Count; i++) {
+                var port = InputPorts.FirstOrDefault(p => p.Name == inputs[i].Name) as NodeSystemLib2.FormatData1D.InputPortData1D;
+                var samplerate = port?.Samplerate ?? 0;
+                _workerInputs[i] = port;
+                _worker.SetPort(
+                    false, i, samplerate,
+                    DefaultParameters.DefaultQueueMilliseconds.ToSamples(samplerate),
+                    DefaultParameters.DefaultBufferMilliseconds.ToSamples(samplerate)
+                );
+            }
+
+            _worker.Prepare();
+
+            var outputs = _worker.Outputs;
+            _workerOutputs = new NodeSystemLib2.FormatData1D.OutputPortData1D[outputs.Count];
+            var scratchSize = 1;
+
+            for (int i = 0; i < outputs.Count; i++) {
+                var port = OutputPorts.FirstOrDefault(p => p.Name == outputs[i].Name) as NodeSystemLib2.FormatData1D.OutputPortData1D;
+                var samplerate = _worker.GetSamplerate(true, i);
+
+                // the script only reports a samplerate if it called SetSamplerate in prepare
+                if (port != null && samplerate > 0) {
+                    port.Samplerate = samplerate;
+                } else {
+                    samplerate = port?.Samplerate ?? 0;
+                }
+
+                var queueSize = DefaultParameters.DefaultQueueMilliseconds.ToSamples(samplerate);
+                scratchSize = Math.Max(scratchSize, queueSize);
+
+                _workerOutputs[i] = port;
+                _worker.SetPort(true, i, samplerate, queueSize, 0);
+            }
+
+            _worker.LayoutRings();
+            _workerScratch = new double[scratchSize];
+        }
+
+        private void ProcessWorker() {
+            for (int i = 0; i < _workerInputs.Length; i++) {
+                var port = _workerInputs[i];
+                if (port == null) continue;
+
+                var free = _worker.Free(i);
+                if (free == 0) continue;
+
+                var buffer = port.Read(free);
+                _worker.Write(i, buffer.Data, buffer.Available);
+            }
+
+            _worker.Process();
+
+            // samples the output ports can't take yet stay in the worker's rings
+            for (int i = 0; i < _workerOutputs.Length; i++) {
+                var port = _workerOutputs[i];
+                if (port == null) continue;
+
+                int read;
+                while ((read = _worker.Read(i, _workerScratch, Math.Min(_workerScratch.Length, port.Buffer.Free))) > 0) {
+                    port.Buffer.Write(_workerScratch, 0, read);
+                }
+            }
+        }
+
         public override void Transfer() {
             foreach (var port in OutputPorts.OfType<NodeSystemLib2.FormatData1D.OutputPortData1D>()) {
                 port.Transfer();
@@ -155,22 +324,109 @@ namespace MetricPython {
             var portName = argTuple.Get(0).GetString();
             var dataPort = InputPorts.First(port => port.Name == portName) as NodeSystemLib2.FormatData1D.InputPortData1D;
 
-            var buffer = dataPort.Read();
-            return new PyArray(buffer.Data.Take(buffer.Available).ToArray(), false).Object.Handle;
+            PyArrayPool pool;
+            if (!_readPools.TryGetValue(dataPort, out pool)) {
+                pool = new PyArrayPool(dataPort.BufferCapacity);
+                _readPools.Add(dataPort, pool);
+            }
+
+            NodeSystemLib2.FormatData1D.IReadOnlyTimeLocatedBuffer1D<double> buffer;
+            using (PyAllowThreads.Begin()) {
+                buffer = dataPort.Read();
+            }
+
+            // the samples are copied into an array of the port's pool, which only
+            // reuses arrays the script no longer references
+            return pool.Take(buffer.Data, buffer.Available);
+        }
+
+        private void ReleaseReadPools() {
+            foreach (var pool in _readPools.Values) {
+                pool.Dispose();
+            }
+            _readPools.Clear();
         }
 
         private IntPtr WriteDataPort(IntPtr self, IntPtr args) {
             var argTuple = new PyTuple(new PyObject(args, false));
-            var data = new PyArray(argTuple.Get(0));
             var portName = argTuple.Get(1).GetString();
             var dataPort = OutputPorts.First(port => port.Name == portName) as NodeSystemLib2.FormatData1D.OutputPortData1D;
 
-            var result = data.ToArrayDouble();
-            dataPort.Buffer.Write(result, 0, result.Length);
+            // a contiguous float64 array is returned as is, so the samples go into the
+            // port straight from numpy's memory
+            IntPtr data;
+            using (PyMarshal.Begin()) {
+                data = PyDll.PyArray_AsContiguous(argTuple.Get(0).Handle, PyArray.Type.NPY_DOUBLE);
+            }
+
+            if (data == IntPtr.Zero) {
+                return new PyLong(0, false).Handle;
+            }
+
+            try {
+                var count = PyDll.PyArray_GetSize(data);
+                var samples = PyDll.PyArray_GetPointer(data);
+
+                using (PyAllowThreads.Begin()) {
+                    dataPort.Buffer.Write(samples, 0, count);
+                }
+            } finally {
+                PyDll.DecRef(data);
+            }
 
             return new PyLong(1, false).Handle;
         }
 
+        // The view functions hand out the port's ring storage as a tuple of two arrays, the
+        // second one non-empty only where the data wraps around. Input views stay valid until
+        // ConsumeData releases them, output views are published with CommitData.
+        private IntPtr ReadDataView(IntPtr self, IntPtr args) {
+            var argTuple = new PyTuple(new PyObject(args, false));
+            var portName = argTuple.Get(0).GetString();
+            var dataPort = InputPorts.First(port => port.Name == portName) as NodeSystemLib2.FormatData1D.InputPortData1D;
+
+            int offset, count1, count2;
+            var data = dataPort.GetReadSegments(out offset, out count1, out count2);
+            return SegmentTuple(data, offset, count1, count2, false);
+        }
+
+        private IntPtr ConsumeData(IntPtr self, IntPtr args) {
+            var argTuple = new PyTuple(new PyObject(args, false));
+            var portName = argTuple.Get(0).GetString();
+            var count = (int)argTuple.Get(1).GetLong();
+            var dataPort = InputPorts.First(port => port.Name == portName) as NodeSystemLib2.FormatData1D.InputPortData1D;
+
+            var consumed = dataPort.Consume(Math.Max(0, count));
+            return new PyLong(consumed, false).Handle;
+        }
+
+        private IntPtr WriteDataView(IntPtr self, IntPtr args) {
+            var argTuple = new PyTuple(new PyObject(args, false));
+            var portName = argTuple.Get(0).GetString();
+            var dataPort = OutputPorts.First(port => port.Name == portName) as NodeSystemLib2.FormatData1D.OutputPortData1D;
+
+            int offset, count1, count2;
+            var data = dataPort.Buffer.GetWriteSegments(out offset, out count1, out count2);
+            return SegmentTuple(data, offset, count1, count2, true);
+        }
+
+        private IntPtr CommitData(IntPtr self, IntPtr args) {
+            var argTuple = new PyTuple(new PyObject(args, false));
+            var portName = argTuple.Get(0).GetString();
+            var count = (int)argTuple.Get(1).GetLong();
+            var dataPort = OutputPorts.First(port => port.Name == portName) as NodeSystemLib2.FormatData1D.OutputPortData1D;
+
+            var committed = dataPort.Buffer.Commit(Math.Max(0, count));
+            return new PyLong(committed, false).Handle;
+        }
+
+        private static IntPtr SegmentTuple(double[] data, int offset, int count1, int count2, bool writable) {
+            var tuple = new PyTuple(2, false);
+            tuple.Set(0, PyArray.Wrap(data, offset, count1, writable, false).Object);
+            tuple.Set(1, PyArray.Wrap(data, 0, count2, writable, false).Object);
+            return tuple.Object.Handle;
+        }
+
         private void Editor_OnReload(object sender, Editor.ReloadEventArgs e) {
             if (State != Graph.State.Stopped) return;
             _code = e.Text;
@@ -182,20 +438,82 @@ namespace MetricPython {
         }
 
         private void ReloadCode() {
-            _ctx?.Dispose();
-            _ctx = null;
+            if (RunsInWorker) {
+                ReloadWorker();
+                return;
+            }
+
+            _worker?.Dispose();
+            _worker = null;
+
+            using (PyGil.Acquire()) {
+                ReleaseReadPools();
+                _process?.Dispose();
+                _process = null;
+                _ctx?.Dispose();
+                _ctx = null;
+
+                var mod = new PyModule("Flumin", _moduleDef);
+
+                try {
+                    _ctx = PyContext.FromCode(_code, new[] { mod });
+                    DisplayPythonError(null);
+                } catch (PyException e) {
+                    DisplayPythonError(e);
+                    Parent.Context.Notify(new GraphNotification(this, GraphNotification.NotificationType.Error, "Error in python code: " + e.Message));
+                }
+
+                if (_ctx != null) GetPortDefs();
+            }
+        }
+
+        private void ReloadWorker() {
+            using (PyGil.Acquire()) {
+                ReleaseReadPools();
+                _process?.Dispose();
+                _process = null;
+                _ctx?.Dispose();
+                _ctx = null;
+            }
 
-            var mod = new PyModule("Flumin", _moduleDef);
+            if (_worker == null || _worker.IsDead) {
+                _worker?.Dispose();
+                _worker = null;
+
+                try {
+                    _worker = PyWorker.Acquire(PythonDir);
+                } catch (PyException e) {
+                    Parent.Context.Notify(new GraphNotification(this, GraphNotification.NotificationType.Error, "Python: " + e.Message));
+                    return;
+                }
+            }
 
             try {
-                _ctx = PyContext.FromCode(_code, new[] { mod });
+                _worker.Load(_code);
                 DisplayPythonError(null);
             } catch (PyException e) {
                 DisplayPythonError(e);
                 Parent.Context.Notify(new GraphNotification(this, GraphNotification.NotificationType.Error, "Error in python code: " + e.Message));
+                _worker.Dispose();
+                _worker = null;
+                return;
+            }
+
+            try {
+                _worker.Init();
+            } catch (PyException e) {
+                DisplayPythonError(e);
+                Parent.Context.Notify(new GraphNotification(this, GraphNotification.NotificationType.Error,
+                    $"Python: While executing init function: {e.Message}"));
+                _worker.Dispose();
+                _worker = null;
+                return;
             }
 
-            if (_ctx != null) GetPortDefs();
+            ApplyPortDefs(
+                _worker.Inputs.Select(p => Tuple.Create(p.Name, p.Kind == PyWorker.PortKind.Data ? "data" : "value")).ToList(),
+                _worker.Outputs.Select(p => Tuple.Create(p.Name, p.Kind == PyWorker.PortKind.Data ? "data" : "value")).ToList()
+            );
         }
 
         private void DisplayPythonError(PyException e) {
@@ -232,100 +550,113 @@ namespace MetricPython {
                 return;
             }
 
-            var existingInputs = InputPorts.ToList();
-            var existingOutputs = OutputPorts.ToList();
+            var inputs = new List<Tuple<string, string>>();
+            var outputs = new List<Tuple<string, string>>();
 
             using (var portDefs = new PyDict(callResult)) {
-
                 using (var portInDefs = new PyList(portDefs["in"])) {
                     foreach (var item in portInDefs) {
                         var tuple = new PyTuple(item);
-                        var portName = new PyString(tuple.Get(0).Handle, false).Value;
-                        var portType = new PyString(tuple.Get(1).Handle, false).Value;
-
-                        var existingPort = existingInputs.FirstOrDefault(p => p.Name == portName);
-
-                        try {
-                            switch (portType) {
-                                case "data":
-                                    if (existingPort != null) {
-                                        if (!existingPort.DataType.Equals(PortDataTypes.TypeIdSignal1D)) {
-                                            RemovePort(existingPort);
-                                            new NodeSystemLib2.FormatData1D.InputPortData1D(this, portName);
-                                        }
-                                        existingInputs.Remove(existingPort);
-                                    } else {
-                                        new NodeSystemLib2.FormatData1D.InputPortData1D(this, portName);
-                                    }
-                                    break;
-                                case "value":
-                                    if (existingPort != null) {
-                                        if (!existingPort.DataType.Equals(PortDataTypes.TypeIdValueDouble)) {
-                                            RemovePort(existingPort);
-                                            new NodeSystemLib2.FormatValue.InputPortValueDouble(this, portName);
-                                        }
-                                        existingInputs.Remove(existingPort);
-                                    } else {
-                                        new NodeSystemLib2.FormatValue.InputPortValueDouble(this, portName);
-                                    }
-                                    break;
-                                default:
-                                    Parent.Context.Notify(new GraphNotification(this, GraphNotification.NotificationType.Error, $"Python: unknown port format '{portType}' for input port named {portName}"));
-                                    break;
-                            }
-                        } catch (Exception e) {
-                            Parent.Context.Notify(new GraphNotification(this, GraphNotification.NotificationType.Error, $"Python: error while processing input port: {portName}: {e.Message}"));
-                        }
+                        inputs.Add(Tuple.Create(new PyString(tuple.Get(0).Handle, false).Value, new PyString(tuple.Get(1).Handle, false).Value));
                     }
                 }
 
-                foreach (var port in existingInputs) {
-                    RemovePort(port);
-                }
-
                 using (var portOutDefs = new PyList(portDefs["out"])) {
                     foreach (var item in portOutDefs) {
                         var tuple = new PyTuple(item);
-                        var portName = new PyString(tuple.Get(0).Handle, false).Value;
-                        var portType = new PyString(tuple.Get(1).Handle, false).Value;
-
-                        var existingPort = existingOutputs.FirstOrDefault(p => p.Name == portName);
-
-                        try {
-                            switch (portType)
-                            {
-                                case "data":
-                                    if (existingPort != null) {
-                                        if (!existingPort.DataType.Equals(PortDataTypes.TypeIdSignal1D)) {
-                                            RemovePort(existingPort);
-                                            new NodeSystemLib2.FormatData1D.OutputPortData1D(this, portName);
-                                        }
-                                        existingOutputs.Remove(existingPort);
-                                    } else {
-                                        new NodeSystemLib2.FormatData1D.OutputPortData1D(this, portName);
-                                    }
-                                    break;
-                                case "value":
-                                    if (existingPort != null) {
-                                        if (!existingPort.DataType.Equals(PortDataTypes.TypeIdValueDouble)) {
-                                            RemovePort(existingPort);
-                                            new NodeSystemLib2.FormatValue.OutputPortValueDouble(this, portName);
-                                        }
-                                        existingOutputs.Remove(existingPort);
-                                    } else {
-                                        new NodeSystemLib2.FormatValue.OutputPortValueDouble(this, portName);
-                                    }
-                                    break;
-                                default:
-                                    Parent.Context.Notify(new GraphNotification(this, GraphNotification.NotificationType.Error, $"Python: unknown port format '{portType}' for output port named {portName}"));
-                                    break;
+                        outputs.Add(Tuple.Create(new PyString(tuple.Get(0).Handle, false).Value, new PyString(tuple.Get(1).Handle, false).Value));
+                    }
+                }
+            }
+
+            ApplyPortDefs(inputs, outputs);
+        }
+
+        private void ApplyPortDefs(List<Tuple<string, string>> inputs, List<Tuple<string, string>> outputs) {
+            var existingInputs = InputPorts.ToList();
+            var existingOutputs = OutputPorts.ToList();
+
+            foreach (var def in inputs) {
+                var portName = def.Item1;
+                var portType = def.Item2;
+
+                var existingPort = existingInputs.FirstOrDefault(p => p.Name == portName);
+
+                try {
+                    switch (portType) {
+                        case "data":
+                            if (existingPort != null) {
+                                if (!existingPort.DataType.Equals(PortDataTypes.TypeIdSignal1D)) {
+                                    RemovePort(existingPort);
+                                    new NodeSystemLib2.FormatData1D.InputPortData1D(this, portName);
+                                }
+                                existingInputs.Remove(existingPort);
+                            } else {
+                                new NodeSystemLib2.FormatData1D.InputPortData1D(this, portName);
                             }
-                        } catch (Exception e) {
-                            Parent.Context.Notify(new GraphNotification(this, GraphNotification.NotificationType.Error, $"Python: error while processing output port: {portName}: {e.Message}"));
-                        }
+                            break;
+                        case "value":
+                            if (existingPort != null) {
+                                if (!existingPort.DataType.Equals(PortDataTypes.TypeIdValueDouble)) {
+                                    RemovePort(existingPort);
+                                    new NodeSystemLib2.FormatValue.InputPortValueDouble(this, portName);
+                                }
+                                existingInputs.Remove(existingPort);
+                            } else {
+                                new NodeSystemLib2.FormatValue.InputPortValueDouble(this, portName);
+                            }
+                            break;
+                        default:
+                            Parent.Context.Notify(new GraphNotification(this, GraphNotification.NotificationType.Error, $"Python: unknown port format '{portType}' for input port named {portName}"));
+                            break;
                     }
+                } catch (Exception e) {
+                    Parent.Context.Notify(new GraphNotification(this, GraphNotification.NotificationType.Error, $"Python: error while processing input port: {portName}: {e.Message}"));
                 }
+            }
+
+            foreach (var port in existingInputs) {
+                RemovePort(port);
+            }
 
+            foreach (var def in outputs) {
+                var portName = def.Item1;
+                var portType = def.Item2;
+
+                var existingPort = existingOutputs.FirstOrDefault(p => p.Name == portName);
+
+                try {
+                    switch (portType)
+                    {
+                        case "data":
+                            if (existingPort != null) {
+                                if (!existingPort.DataType.Equals(PortDataTypes.TypeIdSignal1D)) {
+                                    RemovePort(existingPort);
+                                    new NodeSystemLib2.FormatData1D.OutputPortData1D(this, portName);
+                                }
+                                existingOutputs.Remove(existingPort);
+                            } else {
+                                new NodeSystemLib2.FormatData1D.OutputPortData1D(this, portName);
+                            }
+                            break;
+                        case "value":
+                            if (existingPort != null) {
+                                if (!existingPort.DataType.Equals(PortDataTypes.TypeIdValueDouble)) {
+                                    RemovePort(existingPort);
+                                    new NodeSystemLib2.FormatValue.OutputPortValueDouble(this, portName);
+                                }
+                                existingOutputs.Remove(existingPort);
+                            } else {
+                                new NodeSystemLib2.FormatValue.OutputPortValueDouble(this, portName);
+                            }
+                            break;
+                        default:
+                            Parent.Context.Notify(new GraphNotification(this, GraphNotification.NotificationType.Error, $"Python: unknown port format '{portType}' for output port named {portName}"));
+                            break;
+                    }
+                } catch (Exception e) {
+                    Parent.Context.Notify(new GraphNotification(this, GraphNotification.NotificationType.Error, $"Python: error while processing output port: {portName}: {e.Message}"));
+                }
             }
         }
 
@@ -0,0 +1,165 @@
+#include "stdafx.h"
+#include <emmintrin.h>
+#include "Digital.h"
+
+int line_count(unsigned mask) {
+    int count = 0;
+    for (; mask != 0; mask &= mask - 1) count++;
+    return count;
+}
+
+int stream_size(int samples, int mode) {
+    return (mode == UNPACK_MODE::UNPACK_MODE_BITSET) ? (samples + 7) / 8 : samples;
+}
+
+int unpacked_size(int samples, int channels, unsigned mask, int mode) {
+    return channels * line_count(mask) * stream_size(samples, mode);
+}
+
+int unpacked_stride(int samples, int mode) {
+    return stream_size(samples, mode);
+}
+
+// moves the line to the sign bit so movemask collects it, 16 samples at a time
+void unpack_line_bitset(const unsigned* src, int count, int line, unsigned char* dst) {
+    auto shift = _mm_cvtsi32_si128(31 - line);
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        auto a = _mm_sll_epi32(_mm_loadu_si128((const __m128i*) (src + i)), shift);
+        auto b = _mm_sll_epi32(_mm_loadu_si128((const __m128i*) (src + i + 4)), shift);
+        auto c = _mm_sll_epi32(_mm_loadu_si128((const __m128i*) (src + i + 8)), shift);
+        auto d = _mm_sll_epi32(_mm_loadu_si128((const __m128i*) (src + i + 12)), shift);
+
+        auto bits = _mm_movemask_ps(_mm_castsi128_ps(a))
+                 | (_mm_movemask_ps(_mm_castsi128_ps(b)) << 4)
+                 | (_mm_movemask_ps(_mm_castsi128_ps(c)) << 8)
+                 | (_mm_movemask_ps(_mm_castsi128_ps(d)) << 12);
+
+        dst[i / 8] = (unsigned char) bits;
+        dst[i / 8 + 1] = (unsigned char) (bits >> 8);
+    }
+
+    for (; i < count; i++) {
+        if (i % 8 == 0) dst[i / 8] = 0;
+        dst[i / 8] |= ((src[i] >> line) & 1) << (i % 8);
+    }
+}
+
+// isolates the line in every word and narrows 16 words to 16 bytes
+void unpack_line_bytes(const unsigned* src, int count, int line, unsigned char* dst) {
+    auto shift = _mm_cvtsi32_si128(line);
+    auto one = _mm_set1_epi32(1);
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        auto a = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*) (src + i)), shift), one);
+        auto b = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*) (src + i + 4)), shift), one);
+        auto c = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*) (src + i + 8)), shift), one);
+        auto d = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128((const __m128i*) (src + i + 12)), shift), one);
+
+        auto bytes = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128((__m128i*) (dst + i), bytes);
+    }
+
+    for (; i < count; i++) {
+        dst[i] = (unsigned char) ((src[i] >> line) & 1);
+    }
+}
+
+int unpack_lines(const unsigned* src, int samples, int stride, int channels, unsigned mask, int mode, unsigned char* dst) {
+    auto size = stream_size(samples, mode);
+    auto out = dst;
+
+    for (int ch = 0; ch < channels; ch++) {
+        for (int line = 0; line < 32; line++) {
+            if ((mask & (1u << line)) == 0) continue;
+
+            if (mode == UNPACK_MODE::UNPACK_MODE_BITSET) {
+                unpack_line_bitset(src + ch * stride, samples, line, out);
+            } else {
+                unpack_line_bytes(src + ch * stride, samples, line, out);
+            }
+            out += size;
+        }
+    }
+
+    return (int) (out - dst);
+}
+
+int emit_edges(digital_event* dst, int found, int max_events, long long sample, int channel, unsigned changed, unsigned word) {
+    unsigned long line;
+
+    while (changed != 0) {
+        _BitScanForward(&line, changed);
+        changed &= changed - 1;
+
+        if (found < max_events) {
+            dst[found].sample = sample;
+            dst[found].channel = channel;
+            dst[found].line = (short) line;
+            dst[found].rising = (short) ((word >> line) & 1);
+        }
+        found++;
+    }
+
+    return found;
+}
+
+int scan_edges(const unsigned* src, int from, int to, int stride, int channels, unsigned mask, long long first_sample, digital_event* dst, int found, int max_events) {
+    for (int i = from; i < to; i++) {
+        for (int ch = 0; ch < channels; ch++) {
+            auto words = src + ch * stride;
+            auto changed = (words[i] ^ words[i - 1]) & mask;
+            if (changed != 0) {
+                found = emit_edges(dst, found, max_events, first_sample + i, ch, changed, words[i]);
+            }
+        }
+    }
+
+    return found;
+}
+
+int extract_edges(const unsigned* src, int samples, int stride, int channels, unsigned mask, long long first_sample, unsigned* last_words, digital_event* dst, int max_events) {
+    if (samples <= 0) return 0;
+
+    auto lines = _mm_set1_epi32((int) mask);
+    auto zero = _mm_setzero_si128();
+    int found = 0;
+
+    for (int ch = 0; ch < channels; ch++) {
+        auto word = src[ch * stride];
+        auto changed = (word ^ last_words[ch]) & mask;
+        if (changed != 0) {
+            found = emit_edges(dst, found, max_events, first_sample, ch, changed, word);
+        }
+    }
+
+    // xor every word with its predecessor, 8 samples of all channels at a
+    // time. Blocks without an edge cost a few instructions, only the others
+    // are scanned word by word
+    int i = 1;
+    for (; i + 8 <= samples; i += 8) {
+        auto diff = zero;
+
+        for (int ch = 0; ch < channels; ch++) {
+            auto words = src + ch * stride + i;
+            auto a = _mm_xor_si128(_mm_loadu_si128((const __m128i*) words), _mm_loadu_si128((const __m128i*) (words - 1)));
+            auto b = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (words + 4)), _mm_loadu_si128((const __m128i*) (words + 3)));
+            diff = _mm_or_si128(diff, _mm_or_si128(a, b));
+        }
+
+        diff = _mm_and_si128(diff, lines);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(diff, zero)) == 0xFFFF) continue;
+
+        found = scan_edges(src, i, i + 8, stride, channels, mask, first_sample, dst, found, max_events);
+    }
+
+    found = scan_edges(src, i, samples, stride, channels, mask, first_sample, dst, found, max_events);
+
+    for (int ch = 0; ch < channels; ch++) {
+        last_words[ch] = src[ch * stride + samples - 1];
+    }
+
+    return found;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// Kernels for the uInt32 words DAQmxReadDigitalU32 delivers, one word per
+// sample and channel (port).
+
+enum UNPACK_MODE {
+    UNPACK_MODE_NONE = 0,
+    UNPACK_MODE_BITSET,     // one bit per sample, least significant bit first
+    UNPACK_MODE_BYTES       // one byte per sample, 0 or 1
+};
+
+// Bytes unpack_lines writes for the given number of samples per channel
+int unpacked_size(int samples, int channels, unsigned mask, int mode);
+
+// Bytes from the start of one line stream to the next
+int unpacked_stride(int samples, int mode);
+
+// Splits a channel grouped block into one stream per selected line: channel
+// by channel, and inside a channel line by line in ascending bit order.
+// Returns the bytes written to dst
+int unpack_lines(const unsigned* src, int samples, int stride, int channels, unsigned mask, int mode, unsigned char* dst);
+
+// A change of one line between two consecutive samples
+struct digital_event {
+    long long sample;       // index of the first sample with the new level, counted like first_sample
+    int       channel;
+    short     line;
+    short     rising;       // 1 if the line went high, 0 if it went low
+};
+
+// Finds the edges of the lines in mask, ordered by sample, then channel,
+// then line. last_words holds the last word of every channel from the
+// previous block and is updated. Writes at most max_events and returns how
+// many edges were found, which may be more
+int extract_edges(const unsigned* src, int samples, int stride, int channels, unsigned mask, long long first_sample, unsigned* last_words, digital_event* dst, int max_events);
@@ -0,0 +1,351 @@
+#include "stdafx.h"
+#include <vector>
+#include <queue>
+#include "DiskWriter.h"
+
+// unbuffered I/O needs sector aligned sizes and offsets. 4096 covers both
+// 512 byte and advanced format drives
+const int SECTOR_SIZE          = 4096;
+const int MAX_WRITES_IN_FLIGHT = 2;
+// a partly filled block is written at least this often, so a crash loses
+// no more than this much of the recording
+const int FLUSH_INTERVAL_MS    = 1000;
+
+struct disk_block {
+    char*      data;
+    int        used;
+    int        carried;     // bytes at the start that the previous, flushed block already wrote
+    bool       failed;
+    OVERLAPPED overlapped;
+};
+
+struct disk_writer {
+    HANDLE                   hFile;
+    HANDLE                   hThread;
+    HANDLE                   mutex_blocks;
+    HANDLE                   full_event;    // auto reset, set when a block was queued
+    volatile bool            stop;
+    int                      block_size;
+    std::vector<disk_block*> blocks;
+    std::queue<disk_block*>  free_blocks;
+    std::queue<disk_block*>  full_blocks;
+    disk_block*              current;       // being filled, guarded by mutex_blocks
+    long long                file_offset;   // owned by the writer thread
+    long long                file_end;      // file_offset without the padding
+    volatile long long       bytes_written;
+    volatile long long       bytes_dropped;
+    volatile LONG            error;
+};
+
+int align_to_sector(int len) {
+    return (len + SECTOR_SIZE - 1) & ~(SECTOR_SIZE - 1);
+}
+
+void issue_write(disk_writer* writer, disk_block* block) {
+    auto hEvent = block->overlapped.hEvent;
+
+    memset(&block->overlapped, 0, sizeof(block->overlapped));
+    block->overlapped.hEvent = hEvent;
+    block->overlapped.Offset = (DWORD) (writer->file_offset & 0xFFFFFFFF);
+    block->overlapped.OffsetHigh = (DWORD) (writer->file_offset >> 32);
+    block->failed = false;
+
+    // the tail of the last block is padded, the file is trimmed on close
+    auto len = align_to_sector(block->used);
+    memset(block->data + block->used, 0, len - block->used);
+
+    if (!WriteFile(writer->hFile, block->data, len, NULL, &block->overlapped)) {
+        auto error = GetLastError();
+        if (error != ERROR_IO_PENDING) {
+            InterlockedCompareExchange(&writer->error, error, 0);
+            block->failed = true;
+        }
+    }
+
+    // a flushed block ends in a sector the next block writes again, with
+    // the bytes that came after it
+    writer->file_end = writer->file_offset + block->used;
+    writer->file_offset += block->used & ~(SECTOR_SIZE - 1);
+}
+
+void complete_write(disk_writer* writer, disk_block* block) {
+    DWORD transferred = 0;
+
+    if (!block->failed) {
+        if (GetOverlappedResult(writer->hFile, &block->overlapped, &transferred, TRUE)) {
+            InterlockedExchangeAdd64(&writer->bytes_written, block->used - block->carried);
+        } else {
+            InterlockedCompareExchange(&writer->error, GetLastError(), 0);
+        }
+    }
+
+    WaitForSingleObject(writer->mutex_blocks, INFINITE);
+    writer->free_blocks.push(block);
+    ReleaseMutex(writer->mutex_blocks);
+}
+
+// called with mutex_blocks held. Queues the block being filled even though
+// it is not full. Its last, partial sector is carried over into the next
+// block, so the data behind it continues right where it ends
+void flush_current(disk_writer* writer) {
+    auto block = writer->current;
+    if (block == NULL || block->used == block->carried) return;
+    if (writer->free_blocks.size() == 0) return;
+
+    auto next = writer->free_blocks.front();
+    writer->free_blocks.pop();
+
+    auto tail = block->used & (SECTOR_SIZE - 1);
+    memcpy(next->data, block->data + block->used - tail, tail);
+    next->used = tail;
+    next->carried = tail;
+
+    writer->full_blocks.push(block);
+    writer->current = next;
+}
+
+// SetFileValidData needs SeManageVolumePrivilege. Only elevated processes
+// hold it, and even there it has to be enabled first
+bool enable_manage_volume_privilege() {
+    HANDLE hToken;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken)) return false;
+
+    TOKEN_PRIVILEGES privileges;
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+    // AdjustTokenPrivileges succeeds with ERROR_NOT_ALL_ASSIGNED if the
+    // privilege is not held
+    auto enabled = LookupPrivilegeValue(NULL, SE_MANAGE_VOLUME_NAME, &privileges.Privileges[0].Luid) &&
+                   AdjustTokenPrivileges(hToken, FALSE, &privileges, 0, NULL, NULL) &&
+                   GetLastError() == ERROR_SUCCESS;
+
+    CloseHandle(hToken);
+    return enabled;
+}
+
+// moving the end of file alone is not enough: NTFS zero fills everything
+// between the valid data length and a write, and does that synchronously
+// even for unbuffered overlapped writes. SetFileValidData moves the valid
+// data length along, so the writes stay asynchronous. If that is not
+// allowed the file is left empty and grows as it is written
+void preallocate(HANDLE hFile, long long prealloc_bytes) {
+    LARGE_INTEGER size, start;
+    size.QuadPart = prealloc_bytes;
+    start.QuadPart = 0;
+
+    if (!enable_manage_volume_privilege()) return;
+    if (!SetFilePointerEx(hFile, size, NULL, FILE_BEGIN)) return;
+
+    if (!SetEndOfFile(hFile) || !SetFileValidData(hFile, prealloc_bytes)) {
+        SetFilePointerEx(hFile, start, NULL, FILE_BEGIN);
+        SetEndOfFile(hFile);
+        return;
+    }
+
+    SetFilePointerEx(hFile, start, NULL, FILE_BEGIN);
+}
+
+DWORD WINAPI DiskWriterThread(LPVOID pwriter) {
+    auto writer = (disk_writer*) pwriter;
+    std::queue<disk_block*> in_flight;
+    auto last_flush = GetTickCount64();
+    auto overlaps_next = false;
+
+    while (true) {
+        WaitForSingleObject(writer->full_event, FLUSH_INTERVAL_MS);
+
+        if (GetTickCount64() - last_flush >= FLUSH_INTERVAL_MS) {
+            WaitForSingleObject(writer->mutex_blocks, INFINITE);
+            flush_current(writer);
+            ReleaseMutex(writer->mutex_blocks);
+            last_flush = GetTickCount64();
+        }
+
+        while (true) {
+            WaitForSingleObject(writer->mutex_blocks, INFINITE);
+            if (writer->full_blocks.size() == 0) {
+                ReleaseMutex(writer->mutex_blocks);
+                break;
+            }
+            auto block = writer->full_blocks.front();
+            writer->full_blocks.pop();
+            ReleaseMutex(writer->mutex_blocks);
+
+            // overlapped writes may complete in any order. The sector shared
+            // with a flushed block must not be overwritten by its older copy
+            while (in_flight.size() >= MAX_WRITES_IN_FLIGHT || (overlaps_next && in_flight.size() > 0)) {
+                complete_write(writer, in_flight.front());
+                in_flight.pop();
+            }
+
+            issue_write(writer, block);
+            in_flight.push(block);
+            overlaps_next = (block->used & (SECTOR_SIZE - 1)) != 0;
+        }
+
+        // stop is only set after the last block was queued
+        if (writer->stop) break;
+    }
+
+    while (in_flight.size() > 0) {
+        complete_write(writer, in_flight.front());
+        in_flight.pop();
+    }
+
+    return 0;
+}
+
+disk_writer* disk_writer_create(const wchar_t* path, long long prealloc_bytes, int block_size, int block_count) {
+    auto hFile = CreateFileW(
+        path,
+        GENERIC_WRITE,
+        FILE_SHARE_READ,
+        NULL,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED,
+        NULL
+    );
+
+    if (hFile == INVALID_HANDLE_VALUE) return NULL;
+
+    if (prealloc_bytes > 0) {
+        preallocate(hFile, prealloc_bytes);
+    }
+
+    auto writer = new disk_writer();
+    writer->hFile = hFile;
+    writer->mutex_blocks = CreateMutex(NULL, FALSE, NULL);
+    writer->full_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+    writer->stop = false;
+    writer->block_size = align_to_sector(block_size);
+    writer->current = NULL;
+    writer->file_offset = 0;
+    writer->file_end = 0;
+    writer->bytes_written = 0;
+    writer->bytes_dropped = 0;
+    writer->error = 0;
+
+    for (int i = 0; i < block_count; i++) {
+        auto block = new disk_block();
+        block->data = (char*) VirtualAlloc(NULL, writer->block_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        block->used = 0;
+        block->carried = 0;
+        block->overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+        if (block->data == NULL) {
+            CloseHandle(block->overlapped.hEvent);
+            delete block;
+            break;
+        }
+
+        writer->blocks.push_back(block);
+        writer->free_blocks.push(block);
+    }
+
+    writer->hThread = CreateThread(NULL, 0, DiskWriterThread, (LPVOID) writer, 0, NULL);
+
+    if (writer->hThread == NULL || writer->blocks.empty()) {
+        writer->stop = true;
+        disk_writer_destroy(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+// called with mutex_blocks held
+void queue_current(disk_writer* writer) {
+    writer->full_blocks.push(writer->current);
+    writer->current = NULL;
+    SetEvent(writer->full_event);
+}
+
+// called with mutex_blocks held
+void copy_into_blocks(disk_writer* writer, const char* src, int len) {
+    while (len > 0) {
+        if (writer->current == NULL) {
+            writer->current = writer->free_blocks.front();
+            writer->free_blocks.pop();
+
+            writer->current->used = 0;
+            writer->current->carried = 0;
+        }
+
+        auto n = min(len, writer->block_size - writer->current->used);
+        memcpy(writer->current->data + writer->current->used, src, n);
+        writer->current->used += n;
+        src += n;
+        len -= n;
+
+        if (writer->current->used == writer->block_size) {
+            queue_current(writer);
+        }
+    }
+}
+
+bool disk_writer_push(disk_writer* writer, const void* header, int header_len, const void* data, int len) {
+    auto total = header_len + len;
+
+    // the writer thread flushes the current block when it sits partly
+    // filled for too long, so it is only touched with the mutex held
+    WaitForSingleObject(writer->mutex_blocks, INFINITE);
+    auto space = (writer->current != NULL) ? writer->block_size - writer->current->used : 0;
+    auto needed = (total > space) ? (total - space + writer->block_size - 1) / writer->block_size : 0;
+    auto available = (int) writer->free_blocks.size();
+
+    // a record is written completely or not at all, so the file never
+    // contains a header without its data
+    if (needed > available) {
+        ReleaseMutex(writer->mutex_blocks);
+        InterlockedExchangeAdd64(&writer->bytes_dropped, total);
+        return false;
+    }
+
+    copy_into_blocks(writer, (const char*) header, header_len);
+    copy_into_blocks(writer, (const char*) data, len);
+    ReleaseMutex(writer->mutex_blocks);
+
+    return true;
+}
+
+void disk_writer_get_stats(disk_writer* writer, disk_writer_stats* stats) {
+    stats->bytes_written = writer->bytes_written;
+    stats->bytes_dropped = writer->bytes_dropped;
+    stats->error = writer->error;
+
+    WaitForSingleObject(writer->mutex_blocks, INFINITE);
+    stats->blocks_free = (int) writer->free_blocks.size();
+    ReleaseMutex(writer->mutex_blocks);
+}
+
+void disk_writer_destroy(disk_writer* writer) {
+    if (writer->hThread != NULL) {
+        WaitForSingleObject(writer->mutex_blocks, INFINITE);
+        if (writer->current != NULL && writer->current->used > writer->current->carried) {
+            queue_current(writer);
+        }
+        ReleaseMutex(writer->mutex_blocks);
+
+        writer->stop = true;
+        SetEvent(writer->full_event);
+        WaitForSingleObject(writer->hThread, INFINITE);
+        CloseHandle(writer->hThread);
+    }
+
+    // drop the padding of the last block and whatever was preallocated
+    FILE_END_OF_FILE_INFO eof;
+    eof.EndOfFile.QuadPart = writer->file_end;
+    SetFileInformationByHandle(writer->hFile, FileEndOfFileInfo, &eof, sizeof(eof));
+    CloseHandle(writer->hFile);
+
+    for (auto block : writer->blocks) {
+        VirtualFree(block->data, 0, MEM_RELEASE);
+        CloseHandle(block->overlapped.hEvent);
+        delete block;
+    }
+
+    CloseHandle(writer->mutex_blocks);
+    CloseHandle(writer->full_event);
+    delete writer;
+}
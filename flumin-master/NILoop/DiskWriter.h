@@ -0,0 +1,29 @@
+#pragma once
+
+// Streams bytes to a file from a thread of its own. The producer copies
+// into a pool of large sector aligned blocks and never waits for the disk:
+// if no block is free, the data is dropped and counted instead. A block
+// that is still filling is written out about once a second anyway.
+struct disk_writer;
+
+struct disk_writer_stats {
+    long long bytes_written;
+    long long bytes_dropped;
+    int       blocks_free;
+    int       error;            // GetLastError of the first failed write, 0 if none
+};
+
+// prealloc_bytes is reserved on disk up front so the file system does not
+// have to extend the file during the recording. 0 disables it. This needs
+// SeManageVolumePrivilege, without it the file is not preallocated
+disk_writer* disk_writer_create(const wchar_t* path, long long prealloc_bytes, int block_size, int block_count);
+
+// queues header and data as one record. Returns false if the record was
+// dropped because the disk fell behind
+bool disk_writer_push(disk_writer* writer, const void* header, int header_len, const void* data, int len);
+
+void disk_writer_get_stats(disk_writer* writer, disk_writer_stats* stats);
+
+// writes what is left, trims the file to the bytes actually recorded and
+// closes it
+void disk_writer_destroy(disk_writer* writer);
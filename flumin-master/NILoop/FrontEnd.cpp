@@ -0,0 +1,137 @@
+#include "stdafx.h"
+#include <emmintrin.h>
+#include <math.h>
+#include <vector>
+#include "Scaling.h"
+#include "FrontEnd.h"
+
+const double PASSBAND = 0.8;
+
+struct front_end {
+    int                 channels;
+    int                 max_samples;
+    int                 decimation;
+    int                 taps;           // rounded up to an even count
+    std::vector<double> coeffs;         // reversed, so a dot product with the history gives an output
+    std::vector<double> history;        // per channel taps - 1 old samples followed by the block
+    int                 phase;          // block index of the next sample that produces an output
+    long long           position;
+};
+
+// Blackman windowed sinc with a cutoff of cutoff times the sample rate,
+// normalized to unity gain at DC
+void design_lowpass(double* h, int taps, double cutoff) {
+    const double pi = 3.14159265358979323846;
+    auto center = (taps - 1) / 2.0;
+    auto sum = 0.0;
+
+    for (int i = 0; i < taps; i++) {
+        auto x = i - center;
+        auto sinc = (x == 0) ? 2 * cutoff : sin(2 * pi * cutoff * x) / (pi * x);
+        auto window = (taps > 1) ? 0.42 - 0.5 * cos(2 * pi * i / (taps - 1)) + 0.08 * cos(4 * pi * i / (taps - 1)) : 1.0;
+        h[i] = sinc * window;
+        sum += h[i];
+    }
+
+    for (int i = 0; i < taps; i++) {
+        h[i] /= sum;
+    }
+}
+
+front_end* front_end_create(int channels, int max_samples, int decimation, const double* coeffs, int taps) {
+    if (channels <= 0 || max_samples <= 0) return NULL;
+
+    decimation = max(decimation, 1);
+    if (coeffs == NULL && taps <= 0) {
+        taps = 16 * decimation + 1;
+    }
+    if (taps <= 0) return NULL;
+
+    std::vector<double> h(taps);
+    if (coeffs != NULL) {
+        memcpy(&h[0], coeffs, taps * sizeof(double));
+    } else {
+        design_lowpass(&h[0], taps, 0.5 * PASSBAND / decimation);
+    }
+
+    auto fe = new front_end();
+    fe->channels = channels;
+    fe->max_samples = max_samples;
+    fe->decimation = decimation;
+    fe->taps = (taps + 1) & ~1;
+    fe->phase = 0;
+    fe->position = 0;
+
+    // the padding tap is zero and sits in front of the oldest sample
+    fe->coeffs.assign(fe->taps, 0.0);
+    for (int i = 0; i < taps; i++) {
+        fe->coeffs[fe->taps - 1 - i] = h[i];
+    }
+
+    fe->history.assign(channels * (fe->taps - 1 + max_samples), 0.0);
+
+    return fe;
+}
+
+int front_end_max_output(front_end* fe) {
+    return (fe->max_samples + fe->decimation - 1) / fe->decimation;
+}
+
+long long front_end_position(front_end* fe) {
+    return fe->position;
+}
+
+double dot(const double* a, const double* b, int count) {
+    auto sum0 = _mm_setzero_pd();
+    auto sum1 = _mm_setzero_pd();
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    for (; i < count; i += 2) {
+        sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+
+    sum0 = _mm_add_pd(sum0, sum1);
+    double result[2];
+    _mm_storeu_pd(result, sum0);
+    return result[0] + result[1];
+}
+
+int front_end_process(front_end* fe, const void* src, int samples, int stride, const double* scaling, int scaling_count, double* dst) {
+    if (samples > fe->max_samples) return -1;
+
+    auto keep = fe->taps - 1;
+    auto line_len = keep + fe->max_samples;
+    auto outputs = (samples > fe->phase) ? (samples - fe->phase + fe->decimation - 1) / fe->decimation : 0;
+
+    for (int ch = 0; ch < fe->channels; ch++) {
+        auto line = &fe->history[ch * line_len];
+
+        if (scaling != NULL) {
+            scale_i16((const short*) src + ch * stride, line + keep, samples, scaling + ch * scaling_count, scaling_count);
+        } else {
+            memcpy(line + keep, (const double*) src + ch * stride, samples * sizeof(double));
+        }
+
+        // output n belongs to block sample phase + n * decimation. Its
+        // window ends there and starts taps - 1 samples earlier
+        for (int n = 0; n < outputs; n++) {
+            auto k = fe->phase + n * fe->decimation;
+            dst[ch * outputs + n] = dot(&fe->coeffs[0], line + k, fe->taps);
+        }
+
+        memmove(line, line + samples, keep * sizeof(double));
+    }
+
+    fe->phase += outputs * fe->decimation - samples;
+    fe->position += outputs;
+
+    return outputs;
+}
+
+void front_end_destroy(front_end* fe) {
+    delete fe;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// Anti-alias filter and integer decimation of float64 channels, run by the
+// acquisition loop before a buffer is queued. Raw int16 input is scaled on
+// the way in. The filter and the decimation phase carry over from one block
+// to the next, so blocks of any size produce the same output.
+struct front_end;
+
+// coeffs NULL designs a windowed sinc low-pass of taps taps (0 for
+// 16 * decimation + 1) that passes 0.8 of the reduced Nyquist frequency.
+// max_samples is the largest block front_end_process accepts. It may be
+// smaller than the decimation, the output samples then span several blocks
+front_end* front_end_create(int channels, int max_samples, int decimation, const double* coeffs, int taps);
+
+// samples per channel the next call can return at most
+int front_end_max_output(front_end* fe);
+
+// index of the next output sample, counted from the first block
+long long front_end_position(front_end* fe);
+
+// Filters and decimates a channel grouped block of samples per channel,
+// laid out with stride. With scaling set, src holds int16 codes and scaling
+// holds scaling_count polynomial coefficients per channel. dst receives the
+// output channel by channel without gaps. Returns the output samples per
+// channel, which can be 0 for blocks shorter than the decimation
+int front_end_process(front_end* fe, const void* src, int samples, int stride, const double* scaling, int scaling_count, double* dst);
+
+void front_end_destroy(front_end* fe);
@@ -1,155 +1,1580 @@
 #include "stdafx.h"
+#include <avrt.h>
 #include <vector>
 #include <queue>
+#include <deque>
+#include <algorithm>
 #include <map>
 #include "NILoop.h"
+#include "Scaling.h"
+#include "DiskWriter.h"
+#include "Telemetry.h"
+#include "Replay.h"
+#include "Digital.h"
+#include "FrontEnd.h"
 
-enum ERR_CODE {
-    ERR_CODE_SUCCESS = 0,
-    ERR_CODE_READ_FAILED = -1
+struct buffer {
+    void* parent;
+    void* pData;
+    int len;
+    int result;
+    int id;
+    bool leased;
+    long long sequence;     // per task, counts every read including failed ones
+    long long timestamp;    // QueryPerformanceCounter when the read returned
+    long long first_sample; // samples per channel the task acquired before this buffer
+    int samples;            // samples per channel the read actually returned
+    int stride;             // samples per channel the buffer is laid out for
+    int refs;               // readers that still have to release the buffer
+};
+
+// single producer, single consumer ring of one channel. Positions count
+// samples since start and only grow, the ring index is position % capacity
+struct channel_ring {
+    char*              data;
+    int                capacity;
+    int                sample_size;
+    volatile long long write_pos;
+    volatile long long read_pos;
+    volatile long long dropped;     // samples that did not fit because the consumer fell behind
+};
+
+// A consumer of a task that sees every buffer, independent of the other
+// readers. cursor is the sequence number of the next buffer it gets
+struct task_reader {
+    int       id;
+    long long cursor;
+    HANDLE    ready_event;      // manual reset, set while the reader has buffers to take
+    std::vector<int> leases;    // ids of the buffers it took and did not release yet
+};
+
+struct task_state {
+    handle_info          info;
+    std::vector<buffer*> pool;
+    std::queue<buffer*>  free_buffers;
+    std::queue<buffer*>  read_buffers;
+    HANDLE               ready_event;   // manual reset, set while read_buffers is not empty
+    char*                arena;
+    int                  arena_size;
+    int                  arena_stride;
+    int                  arena_committed;   // bytes from the start of the arena backed by memory
+    bool                 arena_locked;
+    int                  buffer_len;
+    int                  depth;
+    int                  max_depth;
+    pool_stats           stats;
+    bool                 exhausted;     // the last pass found no free buffer
+    long long            sequence;
+    long long            samples_acquired;
+    int                  channels;
+    std::vector<double>  scaling;   // MAX_SCALING_COEFFS per channel, for raw tasks
+    std::vector<channel_ring> rings;
+    disk_writer*         recorder;
+    task_telemetry       telemetry;
+    int                  prefill;
+    bool                 output_started;
+    bool                 starved;   // an underrun was counted for the current gap
+    replay_source*       replay;
+    int                  chunk;
+    double               sample_rate;
+    // with readers registered, filled buffers go here instead of read_buffers,
+    // in sequence order. A buffer is recycled once every reader released it
+    std::deque<buffer*>  shared;
+    std::vector<task_reader*> readers;
+    int                  next_reader_id;
+    std::vector<unsigned char> unpacked;
+    // edge events, one digital_event per ring entry
+    channel_ring         events;
+    std::vector<unsigned> last_words;
+    std::vector<digital_event> edge_scratch;
+    bool                 edges_primed;
+    front_end*           filter;
+    std::vector<double>  filtered;
+};
+
+const int POOL_SIZE          = 5;
+const int ARENA_ALIGNMENT    = 64;
+const int MAX_SCALING_COEFFS = 4;
+const int RECORD_BLOCK_SIZE  = 4 * 1024 * 1024;
+const int RECORD_BLOCK_COUNT = 8;
+const int EVENT_CAPACITY     = 65536;
+
+buffer* buffer_create(task_state* parent, int size) {
+    auto result = new buffer();
+    result->pData = new char[size];
+    result->parent = parent;
+    result->len = size;
+    result->result = 0;
+    result->id = (int) parent->pool.size();
+    result->leased = false;
+    return result;
+}
+
+buffer* buffer_create_in_arena(task_state* parent, int offset, int size) {
+    auto result = new buffer();
+    result->pData = parent->arena + offset;
+    result->parent = parent;
+    result->len = size;
+    result->result = 0;
+    result->id = (int) parent->pool.size();
+    result->leased = false;
+    return result;
+}
+
+void buffer_destroy(buffer* b) {
+    auto parent = (task_state*) b->parent;
+    if (parent->arena == NULL) {
+        delete [] (char*) b->pData;
+    }
+    delete b;
+}
+
+int sample_size(const handle_info& info) {
+    if (info.type == TASK_TYPE::TASK_TYPE_ANALOG_INPUT) {
+        return (info.sample_format == SAMPLE_FORMAT::SAMPLE_FORMAT_RAW_I16) ? 2 : 8;
+    }
+    if (info.type == TASK_TYPE::TASK_TYPE_ANALOG_OUTPUT) {
+        return 8;
+    }
+    return 4;
+}
+
+bool is_output(const handle_info& info) {
+    return info.type == TASK_TYPE::TASK_TYPE_ANALOG_OUTPUT || info.type == TASK_TYPE::TASK_TYPE_DIGITAL_OUTPUT;
+}
+
+// reads the polynomials that turn the raw codes of every channel of the task
+// into volts. Unused higher order coefficients stay zero
+int query_scaling(task_state* task) {
+    uInt32 channels = 0;
+
+    auto result = DAQmxGetTaskNumChans(task->info.handle, &channels);
+    if (result < 0) return result;
+
+    task->channels = channels;
+    task->scaling.assign(channels * MAX_SCALING_COEFFS, 0.0);
+
+    for (uInt32 i = 0; i < channels; i++) {
+        char name[256];
+
+        result = DAQmxGetNthTaskChannel(task->info.handle, i + 1, name, sizeof(name));
+        if (result < 0) return result;
+
+        result = DAQmxGetAIDevScalingCoeff(task->info.handle, name, &task->scaling[i * MAX_SCALING_COEFFS], MAX_SCALING_COEFFS);
+        if (result < 0) return result;
+    }
+
+    return 0;
+}
+
+// commits and locks the arena up to the end of the first count buffers
+bool arena_commit(task_state* task, int count) {
+    auto end = count * task->arena_stride;
+    if (end <= task->arena_committed) return true;
+
+    auto start = task->arena + task->arena_committed;
+    auto len = end - task->arena_committed;
+    if (VirtualAlloc(start, len, MEM_COMMIT, PAGE_READWRITE) == NULL) return false;
+
+    // locking can fail if the working set is too small. the arena is still
+    // usable then, it just might get paged out
+    if (task->arena_locked) {
+        task->arena_locked = VirtualLock(start, len) != FALSE;
+    }
+
+    task->arena_committed = end;
+    return true;
+}
+
+// the arena can't be resized without moving buffers the consumer may hold,
+// so address space for max_depth buffers is reserved right away. Memory is
+// only committed for the depth buffers in circulation, task_grow commits
+// the rest as it needs it
+bool task_allocate_arena(task_state* task, int count, int size) {
+    task->arena_stride = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+    task->arena_size = task->arena_stride * task->max_depth;
+    task->arena = (char*) VirtualAlloc(NULL, task->arena_size, MEM_RESERVE, PAGE_READWRITE);
+    if (task->arena == NULL) return false;
+
+    task->arena_committed = 0;
+    task->arena_locked = true;
+    if (!arena_commit(task, count)) return false;
+
+    auto stride = task->arena_stride;
+
+    for (int i = 0; i < task->max_depth; i++) {
+        auto buf = buffer_create_in_arena(task, i * stride, size);
+        task->pool.push_back(buf);
+        if (i < count) task->free_buffers.push(buf);
+    }
+
+    return true;
+}
+
+void task_allocate_heap(task_state* task, int count, int size) {
+    for (int i = 0; i < count; i++) {
+        auto buf = buffer_create(task, size);
+        task->pool.push_back(buf);
+        task->free_buffers.push(buf);
+    }
+}
+
+// called by the acquisition loop with the task mutex held when no free
+// buffer is left. Adds one more buffer to the free queue if the memory
+// cap allows it
+bool task_grow(task_state* task) {
+    if (task->depth >= task->max_depth) return false;
+
+    if (task->arena != NULL) {
+        if (!arena_commit(task, task->depth + 1)) return false;
+        task->free_buffers.push(task->pool[task->depth]);
+    } else {
+        auto buf = buffer_create(task, task->buffer_len);
+        task->pool.push_back(buf);
+        task->free_buffers.push(buf);
+    }
+
+    task->depth++;
+    task->stats.grow_count++;
+
+    return true;
+}
+
+// the consumer knows how much it queues behind the rings and should size
+// them with ring_samples. Without it they hold what the buffer pool could
+// hold at its largest, so planar delivery buffers no less than queueing
+bool task_allocate_rings(task_state* task) {
+    auto capacity = (task->info.ring_samples > 0) ? task->info.ring_samples : task->max_depth * task->info.samples_per_chan;
+    auto size = (task->filter != NULL) ? (int) sizeof(double) : sample_size(task->info);
+
+    if (capacity <= 0) return false;
+
+    task->rings.resize(task->channels);
+
+    for (auto& ring : task->rings) {
+        ring.data = (char*) VirtualAlloc(NULL, (SIZE_T) capacity * size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        ring.capacity = capacity;
+        ring.sample_size = size;
+        ring.write_pos = 0;
+        ring.read_pos = 0;
+        ring.dropped = 0;
+
+        if (ring.data == NULL) return false;
+    }
+
+    return true;
+}
+
+// called by the acquisition loop only. Whatever does not fit is dropped and
+// counted, the loop never waits for the consumer
+void ring_write(channel_ring& ring, const char* src, int samples) {
+    auto read_pos = InterlockedCompareExchange64(&ring.read_pos, 0, 0);
+    auto space = ring.capacity - (int) (ring.write_pos - read_pos);
+    if (samples > space) {
+        InterlockedExchangeAdd64(&ring.dropped, samples - space);
+        samples = space;
+    }
+
+    auto index = (int) (ring.write_pos % ring.capacity);
+    auto first = min(samples, ring.capacity - index);
+
+    memcpy(ring.data + index * ring.sample_size, src, first * ring.sample_size);
+    memcpy(ring.data, src + first * ring.sample_size, (samples - first) * ring.sample_size);
+
+    // publish the samples only after they have been written
+    InterlockedExchange64(&ring.write_pos, ring.write_pos + samples);
+}
+
+void ring_view(channel_ring& ring, channel_view* view) {
+    auto write_pos = InterlockedCompareExchange64(&ring.write_pos, 0, 0);
+    auto available = (int) (write_pos - ring.read_pos);
+    auto index = (int) (ring.read_pos % max(ring.capacity, 1));
+    auto first = min(available, ring.capacity - index);
+
+    view->first = ring.data + index * ring.sample_size;
+    view->first_samples = first;
+    view->second = ring.data;
+    view->second_samples = available - first;
+    view->position = ring.read_pos;
+}
+
+void task_destroy(task_state* task) {
+    for (auto buf : task->pool) {
+        buffer_destroy(buf);
+    }
+
+    for (auto& ring : task->rings) {
+        if (ring.data != NULL) VirtualFree(ring.data, 0, MEM_RELEASE);
+    }
+
+    if (task->events.data != NULL) {
+        VirtualFree(task->events.data, 0, MEM_RELEASE);
+    }
+
+    if (task->filter != NULL) {
+        front_end_destroy(task->filter);
+    }
+
+    if (task->recorder != NULL) {
+        disk_writer_destroy(task->recorder);
+    }
+
+    if (task->replay != NULL) {
+        replay_close(task->replay);
+    }
+
+    if (task->arena != NULL) {
+        if (task->arena_locked && task->arena_committed > 0) {
+            VirtualUnlock(task->arena, task->arena_committed);
+        }
+        VirtualFree(task->arena, 0, MEM_RELEASE);
+    }
+
+    for (auto reader : task->readers) {
+        CloseHandle(reader->ready_event);
+        delete reader;
+    }
+
+    CloseHandle(task->info.mutex_buffers);
+    CloseHandle(task->ready_event);
+    delete task;
+}
+
+// replaces the words of a digital buffer with one stream per selected line.
+// The streams are packed back to back, so the stride becomes their size in
+// bytes: samples in byte mode, samples / 8 rounded up in bitset mode
+void task_unpack(task_state* task, buffer* buf) {
+    auto size = unpack_lines(
+        (const unsigned*) buf->pData,
+        buf->samples,
+        buf->stride,
+        task->channels,
+        task->info.line_mask,
+        task->info.unpack_mode,
+        &task->unpacked[0]
+    );
+
+    memcpy(buf->pData, &task->unpacked[0], size);
+    buf->stride = unpacked_stride(buf->samples, task->info.unpack_mode);
+}
+
+void task_allocate_events(task_state* task) {
+    auto capacity = (task->info.event_capacity > 0) ? task->info.event_capacity : EVENT_CAPACITY;
+    auto& ring = task->events;
+
+    ring.data = (char*) VirtualAlloc(NULL, capacity * sizeof(digital_event), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    ring.capacity = (ring.data != NULL) ? capacity : 0;
+    ring.sample_size = sizeof(digital_event);
+
+    // a buffer can't queue more events than the ring holds, the rest
+    // would be dropped anyway
+    auto lines = 0;
+    for (auto mask = task->info.edge_mask; mask != 0; mask &= mask - 1) lines++;
+    auto worst_case = (long long) task->info.samples_per_chan * task->channels * lines;
+
+    task->edge_scratch.resize((size_t) min(worst_case, (long long) ring.capacity));
+    task->last_words.resize(task->channels);
+}
+
+// queues the edges of a digital buffer. Has to see the words before
+// task_unpack replaces them
+void task_extract_edges(task_state* task, buffer* buf) {
+    // the samples a failed read lost may hold any number of edges, so the
+    // last words are stale. The next good buffer seeds them again
+    if (buf->result < 0) {
+        task->edges_primed = false;
+        return;
+    }
+
+    auto words = (const unsigned*) buf->pData;
+    if (buf->samples <= 0 || task->edge_scratch.empty()) return;
+
+    // the first sample of the task, or after a failed read, has nothing to
+    // compare with and yields no edge
+    if (!task->edges_primed) {
+        for (int ch = 0; ch < task->channels; ch++) {
+            task->last_words[ch] = words[ch * buf->stride];
+        }
+        task->edges_primed = true;
+    }
+
+    auto scratch_size = (int) task->edge_scratch.size();
+    auto found = extract_edges(
+        words,
+        buf->samples,
+        buf->stride,
+        task->channels,
+        task->info.edge_mask,
+        buf->first_sample,
+        &task->last_words[0],
+        &task->edge_scratch[0],
+        scratch_size
+    );
+
+    if (found > scratch_size) {
+        InterlockedExchangeAdd64(&task->events.dropped, found - scratch_size);
+        found = scratch_size;
+    }
+
+    ring_write(task->events, (const char*) &task->edge_scratch[0], found);
+}
+
+// filters and decimates an analog buffer in place. Afterwards it holds
+// float64 samples at the reduced rate and first_sample counts those
+void task_filter(task_state* task, buffer* buf) {
+    auto raw = task->info.sample_format == SAMPLE_FORMAT::SAMPLE_FORMAT_RAW_I16;
+    if (raw && task->scaling.empty()) {
+        buf->result = 1;
+        return;
+    }
+
+    auto first = front_end_position(task->filter);
+    auto samples = front_end_process(
+        task->filter,
+        buf->pData,
+        buf->samples,
+        buf->stride,
+        raw ? &task->scaling[0] : NULL,
+        MAX_SCALING_COEFFS,
+        &task->filtered[0]
+    );
+
+    if (samples < 0) {
+        buf->result = 1;
+        return;
+    }
+
+    memcpy(buf->pData, &task->filtered[0], samples * task->channels * sizeof(double));
+    buf->samples = samples;
+    buf->stride = samples;
+    buf->first_sample = first;
+}
+
+// shared buffers go back to the free queue in order, as soon as the oldest
+// ones are released by everybody
+void task_recycle_shared(task_state* task) {
+    while (task->shared.size() > 0 && task->shared.front()->refs == 0) {
+        task->free_buffers.push(task->shared.front());
+        task->shared.pop_front();
+    }
+}
+
+// hands a filled buffer to the consumers. Called with the task mutex held
+void task_queue(task_state* task, buffer* buf) {
+    if (task->readers.empty()) {
+        task->read_buffers.push(buf);
+        SetEvent(task->ready_event);
+        return;
+    }
+
+    // a reader registered after the buffer was numbered starts behind it
+    // and never takes it, so it doesn't count
+    buf->refs = 0;
+    for (auto reader : task->readers) {
+        if (reader->cursor <= buf->sequence) {
+            buf->refs++;
+            SetEvent(reader->ready_event);
+        }
+    }
+
+    task->shared.push_back(buf);
+    task_recycle_shared(task);
+}
+
+void task_unref(task_state* task, buffer* buf) {
+    buf->refs--;
+    task_recycle_shared(task);
+}
+
+task_reader* find_reader(task_state* task, int id) {
+    for (auto reader : task->readers) {
+        if (reader->id == id) return reader;
+    }
+    return NULL;
+}
+
+bool task_start_recording(task_state* task, const wchar_t* path) {
+    task->recorder = disk_writer_create(path, (long long) task->info.record_prealloc_mb * 1024 * 1024, RECORD_BLOCK_SIZE, RECORD_BLOCK_COUNT);
+    if (task->recorder == NULL) return false;
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+
+    record_file_header header;
+    memcpy(header.magic, "NIRC", 4);
+    header.version = RECORD_VERSION;
+    header.type = task->info.type;
+    header.sample_format = task->info.sample_format;
+    header.samples_per_chan = task->info.samples_per_chan;
+    header.buffer_size = task->info.buffer_size;
+    header.channels = task->channels;
+    header.scaling_count = (int) task->scaling.size();
+    header.timestamp_frequency = freq.QuadPart;
+
+    // raw recordings carry their scaling, so a replay can convert them
+    // without the device
+    disk_writer_push(
+        task->recorder,
+        &header,
+        sizeof(header),
+        task->scaling.empty() ? NULL : &task->scaling[0],
+        header.scaling_count * sizeof(double)
+    );
+    return true;
+}
+
+// the recording has to match the task it stands in for
+bool task_open_replay(task_state* task, const wchar_t* path) {
+    record_file_header header;
+
+    task->replay = replay_open(path, task->info.replay_mode, task->info.replay_loop != 0, &header, &task->scaling);
+    if (task->replay == NULL) return false;
+
+    return header.type == task->info.type &&
+           header.sample_format == task->info.sample_format &&
+           header.samples_per_chan == task->info.samples_per_chan &&
+           header.buffer_size == task->info.buffer_size;
+}
+
+void task_record(task_state* task, buffer* buf) {
+    record_header header;
+    header.sequence = buf->sequence;
+    header.timestamp = buf->timestamp;
+    header.first_sample = buf->first_sample;
+    header.samples = buf->samples;
+    header.stride = buf->stride;
+    header.len = buf->len;
+
+    disk_writer_push(task->recorder, &header, sizeof(header), buf->pData, buf->len);
+}
+
+// one buffer of every task of a sync group, read in the same pass
+struct sync_frame {
+    long long            sequence;
+    std::vector<buffer*> buffers;
+};
+
+// Tasks that share a sample clock. The loop takes a buffer from each of
+// them or from none, reads them one after the other and queues the result
+// as one frame, so the buffers of a frame cover the same samples
+struct sync_group {
+    int                      id;
+    std::vector<task_state*> tasks;
+    HANDLE                   mutex_frames;
+    HANDLE                   ready_event;   // manual reset, set while frames is not empty
+    std::queue<sync_frame*>  frames;
+    std::queue<sync_frame*>  free_frames;
+    long long                sequence;
+    struct poll_thread*      thread;
+};
+
+struct poll_thread_data;
+
+// one reader thread and the tasks it services round robin
+struct poll_thread {
+    poll_thread_data*        parent;
+    std::vector<task_state*> tasks;
+    std::vector<sync_group*> sync_groups;
+    int                      group;
+    unsigned                 affinity_mask;
+    int                      priority;
+    HANDLE                   hThread;
+};
+
+struct poll_thread_data {
+    volatile bool stop;
+    std::vector<task_state*> tasks;
+    std::vector<poll_thread*> threads;
+    std::vector<sync_group*> sync_groups;
+    HANDLE any_ready_event;             // auto reset, set whenever any task queued a buffer
+    long long tick_frequency;
 };
 
-enum TASK_TYPE {
-    TASK_TYPE_ANALOG_INPUT = 0,
-    TASK_TYPE_DIGITAL_INPUT
-};
+// tasks of a group share a thread. The thread runs on the union of their
+// affinity masks with the highest priority any of them asked for
+poll_thread* thread_for_task(poll_thread_data* data, const handle_info& info) {
+    if (info.thread_group != THREAD_GROUP_OWN) {
+        for (auto thread : data->threads) {
+            if (thread->group == info.thread_group) {
+                thread->affinity_mask |= info.affinity_mask;
+                thread->priority = max(thread->priority, info.thread_priority);
+                return thread;
+            }
+        }
+    }
+
+    auto thread = new poll_thread();
+    thread->parent = data;
+    thread->group = info.thread_group;
+    thread->affinity_mask = info.affinity_mask;
+    thread->priority = info.thread_priority;
+    thread->hThread = NULL;
+    data->threads.push_back(thread);
+
+    return thread;
+}
+
+// all tasks of a sync group are serviced by the thread of its first task
+void add_to_sync_group(poll_thread_data* data, task_state* task) {
+    for (auto group : data->sync_groups) {
+        if (group->id == task->info.sync_group) {
+            group->thread->affinity_mask |= task->info.affinity_mask;
+            group->thread->priority = max(group->thread->priority, task->info.thread_priority);
+            group->tasks.push_back(task);
+            return;
+        }
+    }
+
+    auto group = new sync_group();
+    group->id = task->info.sync_group;
+    group->tasks.push_back(task);
+    group->mutex_frames = CreateMutex(NULL, FALSE, NULL);
+    group->ready_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    group->sequence = 0;
+    group->thread = thread_for_task(data, task->info);
+    group->thread->sync_groups.push_back(group);
+    data->sync_groups.push_back(group);
+}
+
+sync_group* find_sync_group(poll_thread_data* data, int id) {
+    for (auto group : data->sync_groups) {
+        if (group->id == id) return group;
+    }
+    return NULL;
+}
+
+void sync_group_destroy(sync_group* group) {
+    while (group->frames.size() > 0) {
+        delete group->frames.front();
+        group->frames.pop();
+    }
+
+    while (group->free_frames.size() > 0) {
+        delete group->free_frames.front();
+        group->free_frames.pop();
+    }
+
+    CloseHandle(group->mutex_frames);
+    CloseHandle(group->ready_event);
+    delete group;
+}
+
+task_state* find_task(poll_thread_data* data, TaskHandle handle) {
+    for (auto task : data->tasks) {
+        if (task->info.handle == handle) return task;
+    }
+    return NULL;
+}
+
+DWORD WINAPI PollThread(LPVOID pdata);
+
+// frees everything start_polling set up. The reader threads must not be
+// running anymore
+void destroy_poll_data(poll_thread_data* data) {
+    // the pool owns every buffer, including the ones still queued or leased
+    for (auto task : data->tasks) {
+        task_destroy(task);
+    }
+
+    for (auto thread : data->threads) {
+        delete thread;
+    }
+
+    for (auto group : data->sync_groups) {
+        sync_group_destroy(group);
+    }
+
+    CloseHandle(data->any_ready_event);
+    delete data;
+}
+
+// tells the reader threads to quit and waits for the ones that were started
+void stop_threads(poll_thread_data* data) {
+    data->stop = true;
+
+    for (auto thread : data->threads) {
+        if (thread->hThread == NULL) continue;
+
+        WaitForSingleObject(thread->hThread, INFINITE);
+        CloseHandle(thread->hThread);
+        thread->hThread = NULL;
+    }
+}
+
+NILOOP_API poll_thread_data* start_polling(handle_info* handles, int handleCount) {
+    poll_thread_data* data = new poll_thread_data();
+    data->any_ready_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    data->tick_frequency = freq.QuadPart;
+
+    for (int i = 0; i < handleCount; i++) {
+        auto task = new task_state();
+        task->info = handles[i];
+        task->info.mutex_buffers = CreateMutex(NULL, FALSE, NULL);
+        task->ready_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+        task->arena = NULL;
+        task->arena_size = 0;
+        task->arena_stride = 0;
+        task->arena_committed = 0;
+        task->arena_locked = false;
+        task->exhausted = false;
+        task->buffer_len = handles[i].buffer_size * sample_size(handles[i]);
+        task->channels = (handles[i].samples_per_chan > 0) ? handles[i].buffer_size / handles[i].samples_per_chan : 0;
+        if (handles[i].type != TASK_TYPE::TASK_TYPE_DIGITAL_INPUT || handles[i].line_mask == 0) {
+            task->info.unpack_mode = UNPACK_MODE::UNPACK_MODE_NONE;
+        }
+        if (handles[i].type != TASK_TYPE::TASK_TYPE_DIGITAL_INPUT) {
+            task->info.edge_mask = 0;
+        }
+        memset(&task->events, 0, sizeof(task->events));
+        task->edges_primed = false;
+        task->filter = NULL;
+        if (handles[i].type == TASK_TYPE::TASK_TYPE_ANALOG_INPUT && (handles[i].decimation > 1 || handles[i].filter_coeffs != NULL)) {
+            // like unpacking, the filtered samples replace the read in the
+            // same buffer
+            task->filter = front_end_create(task->channels, handles[i].samples_per_chan, handles[i].decimation, handles[i].filter_coeffs, handles[i].filter_taps);
+            if (task->filter != NULL) {
+                task->filtered.resize(task->channels * front_end_max_output(task->filter));
+                task->buffer_len = max(task->buffer_len, (int) (task->filtered.size() * sizeof(double)));
+            }
+        }
+        if (task->info.unpack_mode != UNPACK_MODE::UNPACK_MODE_NONE) {
+            // the words are read into the buffer and unpacked in place, so it
+            // has to hold whichever is larger
+            task->unpacked.resize(unpacked_size(handles[i].samples_per_chan, task->channels, handles[i].line_mask, handles[i].unpack_mode));
+            task->buffer_len = max(task->buffer_len, (int) task->unpacked.size());
+        }
+        task->depth = (handles[i].pool_depth > 0) ? handles[i].pool_depth : POOL_SIZE;
+        task->max_depth = task->depth;
+        if (handles[i].pool_max_bytes > 0 && task->buffer_len > 0) {
+            task->max_depth = max(task->depth, handles[i].pool_max_bytes / task->buffer_len);
+        }
+        memset(&task->stats, 0, sizeof(task->stats));
+        task->sequence = 0;
+        task->samples_acquired = 0;
+        task->recorder = NULL;
+        task->replay = NULL;
+        telemetry_reset(&task->telemetry);
+        task->prefill = (handles[i].prefill_buffers > 0) ? handles[i].prefill_buffers : 2;
+        task->output_started = false;
+        task->starved = false;
+        task->chunk = handles[i].samples_per_chan;
+        task->sample_rate = 0.0;
+        task->next_reader_id = 0;
+        // the path and the coefficients are only valid during this call
+        task->info.record_path = NULL;
+        task->info.replay_path = NULL;
+        task->info.filter_coeffs = NULL;
+        data->tasks.push_back(task);
+
+        if (handles[i].type == TASK_TYPE::TASK_TYPE_ANALOG_INPUT &&
+            (handles[i].decimation > 1 || handles[i].filter_coeffs != NULL) &&
+            task->filter == NULL) {
+            destroy_poll_data(data);
+            return NULL;
+        }
+
+        // only input tasks can be grouped. Frames hand out whole buffers,
+        // so grouped tasks can't deliver into channel rings
+        if (handles[i].sync_group != 0 &&
+            (is_output(handles[i]) || (handles[i].flags & TASK_FLAG::TASK_FLAG_PLANAR))) {
+            destroy_poll_data(data);
+            return NULL;
+        }
+
+        if (handles[i].sync_group != 0) {
+            add_to_sync_group(data, task);
+        } else {
+            thread_for_task(data, handles[i])->tasks.push_back(task);
+        }
+
+        if (handles[i].flags & TASK_FLAG::TASK_FLAG_SHARED_ARENA) {
+            if (!task_allocate_arena(task, task->depth, task->buffer_len)) {
+                destroy_poll_data(data);
+                return NULL;
+            }
+        } else {
+            task_allocate_heap(task, task->depth, task->buffer_len);
+        }
+
+        if (handles[i].replay_path != NULL && !task_open_replay(task, handles[i].replay_path)) {
+            destroy_poll_data(data);
+            return NULL;
+        }
+
+        if (task->replay == NULL &&
+            handles[i].type == TASK_TYPE::TASK_TYPE_ANALOG_INPUT &&
+            handles[i].sample_format == SAMPLE_FORMAT::SAMPLE_FORMAT_RAW_I16 &&
+            query_scaling(task) < 0) {
+            destroy_poll_data(data);
+            return NULL;
+        }
+
+        if ((handles[i].flags & TASK_FLAG::TASK_FLAG_PLANAR) &&
+            task->info.unpack_mode == UNPACK_MODE::UNPACK_MODE_NONE &&
+            !task_allocate_rings(task)) {
+            destroy_poll_data(data);
+            return NULL;
+        }
+
+        if (task->info.edge_mask != 0) {
+            task_allocate_events(task);
+        }
+
+        // adaptive reads need the sample rate. Sync groups keep their reads
+        // the same size so the frames stay aligned
+        if (handles[i].latency_target_us > 0 &&
+            (task->replay != NULL || is_output(handles[i]) || handles[i].sync_group != 0 ||
+             DAQmxGetSampClkRate(handles[i].handle, &task->sample_rate) < 0 || task->sample_rate <= 0)) {
+            task->info.latency_target_us = 0;
+        }
+
+        // output tasks start out with every buffer free for the consumer
+        if (is_output(handles[i])) {
+            SetEvent(task->ready_event);
+        }
+
+        if (handles[i].record_path != NULL && !task_start_recording(task, handles[i].record_path)) {
+            destroy_poll_data(data);
+            return NULL;
+        }
+    }
+
+    data->stop = false;
+
+    for (auto thread : data->threads) {
+        thread->hThread = CreateThread(NULL, 0, PollThread, (LPVOID)thread, 0, NULL);
+        if (thread->hThread == NULL) {
+            // the threads that did start already work on the tasks
+            stop_threads(data);
+            destroy_poll_data(data);
+            return NULL;
+        }
+    }
+
+    return data;
+}
+
+NILOOP_API void stop_polling(poll_thread_data* data) {
+    stop_threads(data);
+    destroy_poll_data(data);
+}
+
+// Hands out the oldest filled buffer without copying it. The buffer is kept
+// away from the acquisition loop until it is given back with release_buffer.
+// Return values are the same as for read_buffer. If the read behind the buffer
+// failed, the buffer is recycled right away and the DAQmx error is returned.
+NILOOP_API int acquire_buffer(poll_thread_data* data, TaskHandle handle, buffer_lease* lease) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return 3;
+    if (is_output(task->info)) return 1;
+
+    WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+    if (task->read_buffers.size() == 0) {
+        ReleaseMutex(task->info.mutex_buffers);
+        return 2;
+    }
+
+    auto buf = task->read_buffers.front();
+    task->read_buffers.pop();
+    if (task->read_buffers.size() == 0) {
+        ResetEvent(task->ready_event);
+    }
+
+    if (buf->result < 0) {
+        auto result = buf->result;
+        task->free_buffers.push(buf);
+        ReleaseMutex(task->info.mutex_buffers);
+        return result;
+    }
+
+    buf->leased = true;
+    ReleaseMutex(task->info.mutex_buffers);
+
+    lease->id = buf->id;
+    lease->pData = buf->pData;
+    lease->len = buf->len;
+    lease->offset = (task->arena != NULL) ? (int) ((char*) buf->pData - task->arena) : -1;
+    lease->sequence = buf->sequence;
+    lease->timestamp = buf->timestamp;
+    lease->first_sample = buf->first_sample;
+    lease->samples = buf->samples;
+    lease->stride = buf->stride;
+
+    return 0;
+}
+
+// Blocks until the task has a filled buffer queued. A negative timeout waits
+// forever. Returns 0 if a buffer is ready, 2 on timeout
+NILOOP_API int wait_buffer(poll_thread_data* data, TaskHandle handle, int timeout_ms) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return 3;
+
+    auto result = WaitForSingleObject(task->ready_event, (timeout_ms < 0) ? INFINITE : timeout_ms);
+    return (result == WAIT_OBJECT_0) ? 0 : 2;
+}
+
+// Blocks until any task queued a buffer since the last call returned. Meant
+// for a consumer that services all tasks of a session from one thread
+NILOOP_API int wait_any_buffer(poll_thread_data* data, int timeout_ms) {
+    auto result = WaitForSingleObject(data->any_ready_event, (timeout_ms < 0) ? INFINITE : timeout_ms);
+    return (result == WAIT_OBJECT_0) ? 0 : 2;
+}
+
+// The events behind wait_buffer and wait_any_buffer, for consumers that want
+// to wait on them together with their own handles. They stay owned by NILoop
+// and are closed by stop_polling
+NILOOP_API HANDLE get_ready_event(poll_thread_data* data, TaskHandle handle) {
+    auto task = find_task(data, handle);
+    return (task != NULL) ? task->ready_event : NULL;
+}
+
+NILOOP_API HANDLE get_any_ready_event(poll_thread_data* data) {
+    return data->any_ready_event;
+}
+
+NILOOP_API int acquire_buffer_wait(poll_thread_data* data, TaskHandle handle, buffer_lease* lease, int timeout_ms) {
+    auto deadline = GetTickCount64() + timeout_ms;
+
+    while (true) {
+        auto result = acquire_buffer(data, handle, lease);
+        if (result != 2) return result;
+
+        // another consumer can take the buffer between the wakeup and the
+        // acquire, so wait again with whatever time is left
+        auto remaining = (timeout_ms < 0) ? -1 : (int) (deadline - min(deadline, GetTickCount64()));
+        if (wait_buffer(data, handle, remaining) != 0) return 2;
+    }
+}
+
+NILOOP_API int release_buffer(poll_thread_data* data, TaskHandle handle, int id) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return 3;
+
+    WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+    if (id < 0 || id >= (int) task->pool.size() || !task->pool[id]->leased) {
+        ReleaseMutex(task->info.mutex_buffers);
+        return 1;
+    }
+
+    auto buf = task->pool[id];
+    buf->leased = false;
+    task->free_buffers.push(buf);
+    ReleaseMutex(task->info.mutex_buffers);
+
+    return 0;
+}
+
+// Hands out a free buffer of an output task to be filled. The buffer is laid
+// out by channel and holds samples_per_chan samples per channel. Returns 2
+// if every buffer is queued or being written, wait_buffer blocks until one
+// is free again
+NILOOP_API int acquire_write_buffer(poll_thread_data* data, TaskHandle handle, buffer_lease* lease) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return 3;
+    if (!is_output(task->info)) return 1;
+
+    WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+    if (task->free_buffers.size() == 0 && !task_grow(task)) {
+        ReleaseMutex(task->info.mutex_buffers);
+        return 2;
+    }
+
+    auto buf = task->free_buffers.front();
+    task->free_buffers.pop();
+    if (task->free_buffers.size() == 0) {
+        ResetEvent(task->ready_event);
+    }
+
+    buf->leased = true;
+    ReleaseMutex(task->info.mutex_buffers);
+
+    lease->id = buf->id;
+    lease->pData = buf->pData;
+    lease->len = buf->len;
+    lease->offset = (task->arena != NULL) ? (int) ((char*) buf->pData - task->arena) : -1;
+    lease->sequence = -1;
+    lease->timestamp = 0;
+    lease->first_sample = 0;
+    lease->samples = task->info.samples_per_chan;
+    lease->stride = task->info.samples_per_chan;
+
+    return 0;
+}
+
+// Queues a filled buffer for writing. samples is the number of samples per
+// channel in it, the channels follow each other without gaps. Returns the
+// error of the last failed write if there was one since the last call
+NILOOP_API int submit_write_buffer(poll_thread_data* data, TaskHandle handle, int id, int samples) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return 3;
+
+    WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+    if (!is_output(task->info) || id < 0 || id >= (int) task->pool.size() || !task->pool[id]->leased ||
+        samples < 0 || samples > task->info.samples_per_chan) {
+        ReleaseMutex(task->info.mutex_buffers);
+        return 1;
+    }
+
+    auto buf = task->pool[id];
+    buf->leased = false;
+    buf->samples = samples;
+    buf->stride = samples;
+    task->read_buffers.push(buf);
+
+    auto result = (int) task->info.result;
+    task->info.result = ERR_CODE::ERR_CODE_SUCCESS;
+    ReleaseMutex(task->info.mutex_buffers);
+
+    return (result < 0) ? result : 0;
+}
+
+// Adds a consumer to a task that gets every buffer filled from now on,
+// whatever the other readers do. Returns the reader id or -1 if the task
+// was not found or delivers its samples as sync group frames or into channel
+// rings. Once a task has readers, acquire_buffer and read_buffer see no more
+// buffers
+NILOOP_API int register_reader(poll_thread_data* data, TaskHandle handle) {
+    auto task = find_task(data, handle);
+    if (task == NULL || is_output(task->info) || task->info.sync_group != 0 || !task->rings.empty()) return -1;
+
+    auto reader = new task_reader();
+    reader->ready_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+    WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+    reader->id = task->next_reader_id++;
+    reader->cursor = task->sequence;
+    task->readers.push_back(reader);
+    ReleaseMutex(task->info.mutex_buffers);
+
+    return reader->id;
+}
+
+// Removes a reader. Buffers it has not taken yet and leases it still holds
+// are released for it
+NILOOP_API int unregister_reader(poll_thread_data* data, TaskHandle handle, int reader_id) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return 3;
+
+    WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+    auto reader = find_reader(task, reader_id);
+    if (reader == NULL) {
+        ReleaseMutex(task->info.mutex_buffers);
+        return 1;
+    }
+
+    for (size_t i = 0; i < task->shared.size(); i++) {
+        if (task->shared[i]->sequence >= reader->cursor) {
+            task->shared[i]->refs--;
+        }
+    }
+    for (auto id : reader->leases) {
+        task->pool[id]->refs--;
+    }
+    task_recycle_shared(task);
+
+    task->readers.erase(std::find(task->readers.begin(), task->readers.end(), reader));
+    ReleaseMutex(task->info.mutex_buffers);
+
+    // wakes a wait_reader still blocked on the reader. Its next acquire
+    // finds the reader gone
+    SetEvent(reader->ready_event);
+    CloseHandle(reader->ready_event);
+    delete reader;
+
+    return 0;
+}
+
+// acquire_buffer for one reader. The buffer stays valid until this reader
+// gives it back with release_reader_buffer, whatever the others do
+NILOOP_API int acquire_reader_buffer(poll_thread_data* data, TaskHandle handle, int reader_id, buffer_lease* lease) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return 3;
+
+    WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+    auto reader = find_reader(task, reader_id);
+    if (reader == NULL) {
+        ReleaseMutex(task->info.mutex_buffers);
+        return 1;
+    }
+
+    // the shared queue is in sequence order. It is searched rather than
+    // indexed, so a sequence number that never got queued can't shift the
+    // cursor onto the wrong buffer
+    size_t index = 0;
+    while (index < task->shared.size() && task->shared[index]->sequence < reader->cursor) {
+        index++;
+    }
+
+    if (index == task->shared.size()) {
+        ResetEvent(reader->ready_event);
+        ReleaseMutex(task->info.mutex_buffers);
+        return 2;
+    }
+
+    auto buf = task->shared[index];
+    reader->cursor = buf->sequence + 1;
+    if (index + 1 == task->shared.size()) {
+        ResetEvent(reader->ready_event);
+    }
+
+    if (buf->result < 0) {
+        auto result = buf->result;
+        task_unref(task, buf);
+        ReleaseMutex(task->info.mutex_buffers);
+        return result;
+    }
+
+    reader->leases.push_back(buf->id);
+    ReleaseMutex(task->info.mutex_buffers);
+
+    lease->id = buf->id;
+    lease->pData = buf->pData;
+    lease->len = buf->len;
+    lease->offset = (task->arena != NULL) ? (int) ((char*) buf->pData - task->arena) : -1;
+    lease->sequence = buf->sequence;
+    lease->timestamp = buf->timestamp;
+    lease->first_sample = buf->first_sample;
+    lease->samples = buf->samples;
+    lease->stride = buf->stride;
+
+    return 0;
+}
+
+NILOOP_API int release_reader_buffer(poll_thread_data* data, TaskHandle handle, int reader_id, int id) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return 3;
+
+    WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+    auto reader = find_reader(task, reader_id);
+    if (reader == NULL) {
+        ReleaseMutex(task->info.mutex_buffers);
+        return 1;
+    }
+
+    // only the reader that holds the buffer can give it back, and only once
+    auto lease = std::find(reader->leases.begin(), reader->leases.end(), id);
+    if (lease == reader->leases.end()) {
+        ReleaseMutex(task->info.mutex_buffers);
+        return 1;
+    }
+
+    reader->leases.erase(lease);
+    task_unref(task, task->pool[id]);
+    ReleaseMutex(task->info.mutex_buffers);
+
+    return 0;
+}
+
+// Blocks until the reader has a buffer to take. Returns 0 if one is ready,
+// 2 on timeout
+NILOOP_API int wait_reader(poll_thread_data* data, TaskHandle handle, int reader_id, int timeout_ms) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return 3;
+
+    // unregister_reader may close the event of the reader while this waits
+    // on it, so the wait uses a handle of its own
+    HANDLE event = NULL;
+
+    WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+    auto reader = find_reader(task, reader_id);
+    if (reader != NULL) {
+        DuplicateHandle(GetCurrentProcess(), reader->ready_event, GetCurrentProcess(), &event, SYNCHRONIZE, FALSE, 0);
+    }
+    ReleaseMutex(task->info.mutex_buffers);
+
+    if (event == NULL) return 1;
+
+    auto result = WaitForSingleObject(event, (timeout_ms < 0) ? INFINITE : timeout_ms);
+    CloseHandle(event);
+
+    return (result == WAIT_OBJECT_0) ? 0 : 2;
+}
+
+// Base address and size of the shared arena of a task. Buffer leases of that
+// task report their position in it as offset
+NILOOP_API int get_arena(poll_thread_data* data, TaskHandle handle, void** base, int* size) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return 3;
+    if (task->arena == NULL) return 1;
+
+    *base = task->arena;
+    *size = task->arena_size;
+
+    return 0;
+}
+
+NILOOP_API int get_pool_stats(poll_thread_data* data, TaskHandle handle, pool_stats* stats) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return 3;
+
+    WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+    *stats = task->stats;
+    stats->depth = task->depth;
+    stats->max_depth = task->max_depth;
+    stats->free = (int) task->free_buffers.size();
+    stats->ready = (int) (task->read_buffers.size() + task->shared.size());
+    stats->chunk = task->chunk;
+    ReleaseMutex(task->info.mutex_buffers);
+
+    return 0;
+}
+
+// copies a leased buffer to dest and gives the lease back. The lease keeps
+// describing the copy afterwards
+int copy_and_release(poll_thread_data* data, TaskHandle task, buffer_lease& lease, void* dest, int size) {
+    if (size < lease.len) {
+        release_buffer(data, task, lease.id);
+        return 1;
+    }
+
+    memcpy(dest, lease.pData, lease.len);
+    release_buffer(data, task, lease.id);
+
+    lease.id = -1;
+    lease.pData = dest;
+    lease.offset = -1;
+
+    return 0;
+}
+
+NILOOP_API int read_buffer(poll_thread_data* data, TaskHandle task, void* dest, int size) {
+    buffer_lease lease;
+
+    auto result = acquire_buffer(data, task, &lease);
+    if (result != 0) {
+        return result;
+    }
+
+    return copy_and_release(data, task, lease, dest, size);
+}
+
+NILOOP_API int read_buffer_wait(poll_thread_data* data, TaskHandle task, void* dest, int size, int timeout_ms) {
+    buffer_lease lease;
+
+    auto result = acquire_buffer_wait(data, task, &lease, timeout_ms);
+    if (result != 0) {
+        return result;
+    }
+
+    return copy_and_release(data, task, lease, dest, size);
+}
+
+// read_buffer_wait that also reports sequence number, timestamp and sample
+// counts of the copied buffer in info
+NILOOP_API int read_buffer_info(poll_thread_data* data, TaskHandle task, void* dest, int size, int timeout_ms, buffer_lease* info) {
+    auto result = acquire_buffer_wait(data, task, info, timeout_ms);
+    if (result != 0) {
+        return result;
+    }
 
-struct handle_info {
-    TaskHandle  handle;
-    TASK_TYPE   type;
-    int         samples_per_chan;
-    int         buffer_size;
-    HANDLE      mutex_buffers;
-    ERR_CODE    result;
+    return copy_and_release(data, task, *info, dest, size);
+}
 
-    bool const operator == (const handle_info &o) const { return o.handle == handle; }
-    //bool const operator <  (const handle_info &o) const { return o.handle < handle;  }
-};
+// Blocks until the sync group has a frame queued. Returns 0 if one is
+// ready, 2 on timeout
+NILOOP_API int wait_frame(poll_thread_data* data, int group_id, int timeout_ms) {
+    auto group = find_sync_group(data, group_id);
+    if (group == NULL) return 3;
 
-struct buffer {
-    void* parent;
-    void* pData;
-    int len;
-    int result;
-};
+    auto result = WaitForSingleObject(group->ready_event, (timeout_ms < 0) ? INFINITE : timeout_ms);
+    return (result == WAIT_OBJECT_0) ? 0 : 2;
+}
+
+// Hands out the oldest frame of a sync group: one lease per task, in the
+// order the tasks were passed to start_polling. All leases carry the same
+// sequence number. Every lease has to be given back, with release_frame or
+// one by one with release_buffer. If any read of the frame failed, the whole
+// frame is recycled, the leases are cleared to id -1 and the first DAQmx
+// error is returned. A filtered task that completed no output sample in a
+// frame gets a lease with 0 samples, so the frames stay in step
+NILOOP_API int acquire_frame(poll_thread_data* data, int group_id, buffer_lease* leases, int max_leases) {
+    auto group = find_sync_group(data, group_id);
+    if (group == NULL) return 3;
+    if (max_leases < (int) group->tasks.size()) return 1;
+
+    WaitForSingleObject(group->mutex_frames, INFINITE);
+    if (group->frames.size() == 0) {
+        ReleaseMutex(group->mutex_frames);
+        return 2;
+    }
+
+    auto frame = group->frames.front();
+    group->frames.pop();
+    if (group->frames.size() == 0) {
+        ResetEvent(group->ready_event);
+    }
+    ReleaseMutex(group->mutex_frames);
+
+    auto result = 0;
+    for (auto buf : frame->buffers) {
+        if (buf->result < 0) {
+            result = buf->result;
+            break;
+        }
+    }
+
+    for (int i = 0; i < (int) group->tasks.size(); i++) {
+        auto task = group->tasks[i];
+        auto buf = frame->buffers[i];
+
+        WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+        if (result < 0) {
+            task->free_buffers.push(buf);
+        } else {
+            buf->leased = true;
+        }
+        ReleaseMutex(task->info.mutex_buffers);
+
+        // the buffers of a failed frame are back in the pool already. The
+        // leases must not point the consumer at them
+        if (result < 0) {
+            memset(&leases[i], 0, sizeof(leases[i]));
+            leases[i].id = -1;
+            leases[i].offset = -1;
+            continue;
+        }
+
+        leases[i].id = buf->id;
+        leases[i].pData = buf->pData;
+        leases[i].len = buf->len;
+        leases[i].offset = (task->arena != NULL) ? (int) ((char*) buf->pData - task->arena) : -1;
+        leases[i].sequence = buf->sequence;
+        leases[i].timestamp = buf->timestamp;
+        leases[i].first_sample = buf->first_sample;
+        leases[i].samples = buf->samples;
+        leases[i].stride = buf->stride;
+    }
+
+    WaitForSingleObject(group->mutex_frames, INFINITE);
+    group->free_frames.push(frame);
+    ReleaseMutex(group->mutex_frames);
 
-buffer buffer_create(void* parent, int size) {
-    buffer result;
-    result.pData = new char[size];
-    result.parent = parent;
-    result.len = size;
     return result;
 }
 
-void buffer_destroy(buffer b) {
-    delete [] b.pData;
+NILOOP_API int release_frame(poll_thread_data* data, int group_id, const buffer_lease* leases, int count) {
+    auto group = find_sync_group(data, group_id);
+    if (group == NULL) return 3;
+    if (count != (int) group->tasks.size()) return 1;
+
+    auto result = 0;
+    for (int i = 0; i < count; i++) {
+        result = max(result, release_buffer(data, group->tasks[i]->info.handle, leases[i].id));
+    }
+
+    return result;
 }
 
-struct poll_thread_data {
-    volatile bool stop;
-    std::map<TaskHandle, std::queue<buffer>> free_buffers;
-    std::map<TaskHandle, std::queue<buffer>> read_buffers;
-    std::vector<handle_info> handles;
-    HANDLE hThread;
-    HANDLE hThreadEndEvent;
-};
+channel_ring* find_ring(poll_thread_data* data, TaskHandle handle, int channel) {
+    auto task = find_task(data, handle);
+    if (task == NULL || channel < 0 || channel >= (int) task->rings.size()) return NULL;
+    return &task->rings[channel];
+}
 
-DWORD WINAPI PollThread(LPVOID pdata);
+// the DAQmx error of a failed read of a planar task, reported only once
+int take_ring_error(poll_thread_data* data, TaskHandle handle) {
+    auto task = find_task(data, handle);
 
-NILOOP_API poll_thread_data* start_polling(handle_info* handles, int handleCount) {
-    poll_thread_data* data = new poll_thread_data();
+    WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+    auto result = (int) task->info.result;
+    task->info.result = ERR_CODE::ERR_CODE_SUCCESS;
+    ReleaseMutex(task->info.mutex_buffers);
 
-    for (int i = 0; i < handleCount; i++) {
-        data->handles.push_back(handles[i]);
-        data->handles.back().mutex_buffers = CreateMutex(NULL, FALSE, NULL);
-        std::queue<buffer> queue;
-        for (int j = 0; j < 5; j++) {
-            queue.emplace(buffer_create(data, handles[i].buffer_size * ((handles[i].type == TASK_TYPE::TASK_TYPE_ANALOG_INPUT) ? 8 : 4)));
-        }
-        data->free_buffers.emplace(handles[i].handle, queue);
-    }
+    return result;
+}
 
-    data->stop = false;
-    data->hThreadEndEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+int ring_read(channel_ring& ring, void* dest, int max_samples, int* read) {
+    channel_view view;
+    ring_view(ring, &view);
 
-    data->hThread = CreateThread(NULL, 0, PollThread, (LPVOID)data, 0, NULL);
-    if (data->hThread == NULL) return NULL;
+    auto first = min(view.first_samples, max_samples);
+    auto second = min(view.second_samples, max_samples - first);
 
-    return data;
+    *read = first + second;
+    if (*read == 0) return 2;
+
+    memcpy(dest, view.first, first * ring.sample_size);
+    memcpy((char*) dest + first * ring.sample_size, view.second, second * ring.sample_size);
+
+    InterlockedExchange64(&ring.read_pos, ring.read_pos + *read);
+
+    return 0;
 }
 
-NILOOP_API void stop_polling(poll_thread_data* data) {
-    data->stop = true;
-    WaitForSingleObject(data->hThreadEndEvent, INFINITE);
+// Copies up to max_samples samples of one channel of a planar task to dest.
+// Returns 0 and the number of samples in read, 2 if the ring is empty. If a
+// read of the task failed since the last call, its DAQmx error is returned
+NILOOP_API int read_channel(poll_thread_data* data, TaskHandle handle, int channel, void* dest, int max_samples, int* read) {
+    auto ring = find_ring(data, handle, channel);
+    if (ring == NULL) return 3;
+    if (dest == NULL || read == NULL || max_samples < 0) return 1;
 
-    for (auto& handle : data->handles) {
-        auto& free_queue = data->free_buffers[handle.handle];
-        auto& used_queue = data->read_buffers[handle.handle];
+    *read = 0;
+    auto error = take_ring_error(data, handle);
+    if (error < 0) return error;
 
-        while (free_queue.size() > 0) {
-            buffer_destroy(free_queue.front());
-            free_queue.pop();
-        }
+    return ring_read(*ring, dest, max_samples, read);
+}
 
-        while (used_queue.size() > 0) {
-            buffer_destroy(used_queue.front());
-            used_queue.pop();
-        }
+// Zero-copy access to the readable samples of one channel. The view stays
+// valid until the samples are given back with consume_channel. Failed reads
+// are reported like with read_channel
+NILOOP_API int peek_channel(poll_thread_data* data, TaskHandle handle, int channel, channel_view* view) {
+    auto ring = find_ring(data, handle, channel);
+    if (ring == NULL) return 3;
+    if (view == NULL) return 1;
+
+    auto error = take_ring_error(data, handle);
+    if (error < 0) return error;
+
+    ring_view(*ring, view);
+    return (view->first_samples > 0) ? 0 : 2;
+}
+
+NILOOP_API int consume_channel(poll_thread_data* data, TaskHandle handle, int channel, int samples) {
+    auto ring = find_ring(data, handle, channel);
+    if (ring == NULL) return 3;
+
+    auto available = (int) (InterlockedCompareExchange64(&ring->write_pos, 0, 0) - ring->read_pos);
+    if (samples < 0 || samples > available) return 1;
+
+    InterlockedExchange64(&ring->read_pos, ring->read_pos + samples);
+    return 0;
+}
+
+// samples of the channel that were dropped because its ring was full
+NILOOP_API long long get_channel_dropped(poll_thread_data* data, TaskHandle handle, int channel) {
+    auto ring = find_ring(data, handle, channel);
+    return (ring != NULL) ? ring->dropped : -1;
+}
 
-        CloseHandle(handle.mutex_buffers);
+// Copies up to max_events of the queued edge events of a digital task to
+// dest, oldest first. Returns 0 and the number of events in read, 2 if none
+// are queued, 3 if the task does not extract edges
+NILOOP_API int read_events(poll_thread_data* data, TaskHandle handle, digital_event* dest, int max_events, int* read) {
+    auto task = find_task(data, handle);
+    if (task == NULL || task->events.data == NULL) return 3;
+
+    return ring_read(task->events, dest, max_events, read);
+}
+
+// edges that were dropped because the event queue was full
+NILOOP_API long long get_events_dropped(poll_thread_data* data, TaskHandle handle) {
+    auto task = find_task(data, handle);
+    return (task != NULL && task->events.data != NULL) ? task->events.dropped : -1;
+}
+
+// Copies the cached scaling polynomials of a raw task to coeffs, channel by
+// channel with MAX_SCALING_COEFFS entries each. Returns the number of
+// doubles written or -1 if size is too small
+NILOOP_API int get_scaling_coeffs(poll_thread_data* data, TaskHandle handle, double* coeffs, int size) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return -1;
+    if (size < (int) task->scaling.size()) return -1;
+
+    if (!task->scaling.empty()) {
+        memcpy(coeffs, &task->scaling[0], task->scaling.size() * sizeof(double));
     }
 
-    CloseHandle(data->hThreadEndEvent);
-    CloseHandle(data->hThread);
+    return (int) task->scaling.size();
+}
 
-    delete data;
+// Scales a channel-grouped block of raw codes with one polynomial per channel
+NILOOP_API void scale_raw(const short* src, double* dst, int samples_per_chan, int channels, const double* coeffs, int coeff_count) {
+    for (int ch = 0; ch < channels; ch++) {
+        scale_i16(
+            src + ch * samples_per_chan,
+            dst + ch * samples_per_chan,
+            samples_per_chan,
+            coeffs + ch * coeff_count,
+            coeff_count
+        );
+    }
 }
 
-NILOOP_API int read_buffer(poll_thread_data* data, TaskHandle task, void* dest, int size) {
-    for (int i = 0; i < data->handles.size(); i++) {
-        if (data->handles[i].handle == task) {
-            auto& taskInfo = data->handles[i];
-            auto& read_buffers = data->read_buffers[task];
-            auto& free_buffers = data->free_buffers[task];
-
-            WaitForSingleObject(taskInfo.mutex_buffers, INFINITE);
-            if (read_buffers.size() == 0) {
-                ReleaseMutex(taskInfo.mutex_buffers);
-                return 2;
-            }
+// read_buffer_info for raw tasks: dest receives the scaled float64 samples,
+// so size has to be four times the size of the raw buffer. Tasks that
+// are not raw are copied unchanged
+NILOOP_API int read_buffer_scaled(poll_thread_data* data, TaskHandle handle, double* dest, int size, int timeout_ms, buffer_lease* info) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return 3;
 
-            auto buf = read_buffers.front();
-            read_buffers.pop();
-            ReleaseMutex(taskInfo.mutex_buffers);
+    // the front end already delivers volts
+    if (task->info.sample_format != SAMPLE_FORMAT::SAMPLE_FORMAT_RAW_I16 || task->scaling.empty() || task->filter != NULL) {
+        return read_buffer_info(data, handle, dest, size, timeout_ms, info);
+    }
 
-            if (size < buf.len) {
-                return 1;
-            }
-            if (buf.result >= 0) {
-                memcpy(dest, buf.pData, buf.len);
-            }
+    auto result = acquire_buffer_wait(data, handle, info, timeout_ms);
+    if (result != 0) {
+        return result;
+    }
 
-            WaitForSingleObject(taskInfo.mutex_buffers, INFINITE);
-            free_buffers.emplace(buf);
-            ReleaseMutex(taskInfo.mutex_buffers);
+    // the buffer is laid out for the request, whatever the read returned
+    auto stride = info->stride;
 
-            if (buf.result < 0) {
-                return buf.result;
-            } else {
-                return 0;
-            }
-        }
+    if (size < stride * task->channels * (int) sizeof(double)) {
+        release_buffer(data, handle, info->id);
+        return 1;
     }
 
-    return 3;
+    scale_raw((const short*) info->pData, dest, stride, task->channels, &task->scaling[0], MAX_SCALING_COEFFS);
+    release_buffer(data, handle, info->id);
+
+    info->id = -1;
+    info->pData = dest;
+    info->len = stride * task->channels * sizeof(double);
+    info->offset = -1;
+
+    return 0;
+}
+
+// Read durations, starved sleeps and error counts of a task. Does not take the task
+// mutex, so it can be polled at any rate without disturbing the loop
+NILOOP_API int get_telemetry(poll_thread_data* data, TaskHandle handle, telemetry_stats* stats) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return 3;
+
+    telemetry_snapshot(&task->telemetry, stats);
+    return 0;
+}
+
+// The most recent free and ready queue depths of a task, oldest first.
+// Timestamps are in get_timestamp_frequency ticks. Returns the number of
+// samples copied or -1 if the task was not found
+NILOOP_API int get_depth_history(poll_thread_data* data, TaskHandle handle, depth_sample* dest, int max_samples) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return -1;
+
+    return telemetry_depth_history(&task->telemetry, dest, max_samples);
+}
+
+// Bytes written and dropped by the recorder of a task. Returns 1 if the task
+// does not record
+NILOOP_API int get_recording_stats(poll_thread_data* data, TaskHandle handle, disk_writer_stats* stats) {
+    auto task = find_task(data, handle);
+    if (task == NULL) return 3;
+    if (task->recorder == NULL) return 1;
+
+    disk_writer_get_stats(task->recorder, stats);
+    return 0;
+}
+
+// ticks per second of the buffer timestamps
+NILOOP_API long long get_timestamp_frequency() {
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    return freq.QuadPart;
 }
 
-int fill_buffer_analog(const handle_info &handle, buffer* buf) {
+int fill_buffer_analog(const handle_info &handle, buffer* buf, int samples) {
     int32 read = 0;
 
     auto result = DAQmxReadAnalogF64(
         handle.handle,
-        handle.samples_per_chan,
+        samples,
         3.0,
         DAQmx_Val_GroupByChannel,
         (float64*) buf->pData,
@@ -158,60 +1583,516 @@ int fill_buffer_analog(const handle_info &handle, buffer* buf) {
         NULL
     );
 
+    buf->samples = read;
+    buf->stride = samples;
+    return result;
+}
+
+int fill_buffer_analog_raw(const handle_info &handle, buffer* buf, int samples) {
+    int32 read = 0;
+
+    auto result = DAQmxReadBinaryI16(
+        handle.handle,
+        samples,
+        3.0,
+        DAQmx_Val_GroupByChannel,
+        (int16*) buf->pData,
+        handle.buffer_size,
+        &read,
+        NULL
+    );
+
+    buf->samples = read;
+    buf->stride = samples;
     return result;
 }
 
-int fill_buffer_digital(const handle_info& handle, buffer* buf) {
+int fill_buffer_digital(const handle_info& handle, buffer* buf, int samples) {
     int32 read = 0;
-    
+
     auto result = DAQmxReadDigitalU32(
-        handle.handle, 
-        handle.samples_per_chan, 
-        3.0, 
-        DAQmx_Val_GroupByChannel, 
-        (uInt32*) buf->pData, 
-        handle.buffer_size, 
-        &read, 
+        handle.handle,
+        samples,
+        3.0,
+        DAQmx_Val_GroupByChannel,
+        (uInt32*) buf->pData,
+        handle.buffer_size,
+        &read,
         NULL
     );
 
+    buf->samples = read;
+    buf->stride = samples;
     return result;
 }
 
-DWORD WINAPI PollThread(LPVOID pdata) {
-    auto data = (poll_thread_data*) pdata;
-    while (!data->stop) {
-        for (auto& handle : data->handles) {
+int write_buffer_analog(const handle_info& handle, buffer* buf) {
+    int32 written = 0;
+
+    return DAQmxWriteAnalogF64(
+        handle.handle,
+        buf->samples,
+        false,
+        3.0,
+        DAQmx_Val_GroupByChannel,
+        (const float64*) buf->pData,
+        &written,
+        NULL
+    );
+}
+
+int write_buffer_digital(const handle_info& handle, buffer* buf) {
+    int32 written = 0;
+
+    return DAQmxWriteDigitalU32(
+        handle.handle,
+        buf->samples,
+        false,
+        3.0,
+        DAQmx_Val_GroupByChannel,
+        (const uInt32*) buf->pData,
+        &written,
+        NULL
+    );
+}
+
+HANDLE apply_thread_settings(poll_thread* thread) {
+    HANDLE hMmcss = NULL;
+
+    if (thread->affinity_mask != 0) {
+        SetThreadAffinityMask(GetCurrentThread(), thread->affinity_mask);
+    }
+
+    switch (thread->priority) {
+    case READER_PRIORITY::READER_PRIORITY_HIGH:
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+        break;
+    case READER_PRIORITY::READER_PRIORITY_REALTIME:
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+        break;
+    case READER_PRIORITY::READER_PRIORITY_MMCSS: {
+        DWORD taskIndex = 0;
+        hMmcss = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+        if (hMmcss == NULL) {
+            // service not available, fall back to the plain thread priority
+            SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    return hMmcss;
+}
+
+// Size of the next read of a task with a latency target. The target alone
+// would be ideal if nothing ever fell behind, so it is stretched while the
+// device buffer holds a backlog or the consumer takes buffers slower than
+// they come, and shrunk back to the target once both caught up
+int adapt_chunk(task_state* task, int ready) {
+    auto& info = task->info;
+    auto lowest = (info.chunk_min > 0) ? info.chunk_min : info.samples_per_chan / 16;
+    lowest = max(1, min(lowest, info.samples_per_chan));
+
+    auto target = (int) (task->sample_rate * info.latency_target_us / 1000000.0);
+    target = max(lowest, min(target, info.samples_per_chan));
+
+    uInt32 available = 0;
+    if (DAQmxGetReadAvailSampPerChan(info.handle, &available) < 0) {
+        available = 0;
+    }
+
+    int chunk;
+    if ((int) available > target) {
+        // catch up with one large read instead of many small ones
+        chunk = (int) available;
+    } else if (ready > 1) {
+        // fewer, larger buffers cut the per buffer overhead of the consumer
+        chunk = task->chunk * 2;
+    } else {
+        chunk = (task->chunk > target) ? max(target, task->chunk / 2) : target;
+    }
+
+    return max(lowest, min(chunk, info.samples_per_chan));
+}
+
+int fill_buffer(task_state* task, buffer* buf) {
+    auto& handle = task->info;
+
+    if (task->replay != NULL) {
+        return replay_read(task->replay, buf->pData, buf->len, &buf->samples, &buf->stride);
+    }
+
+    switch (handle.type) {
+    case TASK_TYPE::TASK_TYPE_ANALOG_INPUT:
+        if (handle.sample_format == SAMPLE_FORMAT::SAMPLE_FORMAT_RAW_I16) {
+            return fill_buffer_analog_raw(handle, buf, task->chunk);
+        }
+        return fill_buffer_analog(handle, buf, task->chunk);
+    case TASK_TYPE::TASK_TYPE_DIGITAL_INPUT:
+        return fill_buffer_digital(handle, buf, task->chunk);
+    default:
+        throw std::exception("NILoop: task type not implemented");
+    }
+}
+
+void poll_input(poll_thread_data* data, task_state* task) {
+    auto& handle = task->info;
+
+    if (task->replay != NULL && replay_finished(task->replay)) {
+        Sleep(1);
+        return;
+    }
+
+    WaitForSingleObject(handle.mutex_buffers, INFINITE);
+    auto& free_buffers = task->free_buffers;
+    auto& read_buffers = task->read_buffers;
+
+    if (free_buffers.size() > 0 || task_grow(task)) {
+        auto buffer = free_buffers.front();
+        free_buffers.pop();
+        task->exhausted = false;
+
+        // numbered under the mutex, register_reader starts new readers
+        // at task->sequence
+        buffer->sequence = task->sequence++;
+
+        auto in_use = task->depth - (int) free_buffers.size();
+        if (in_use > task->stats.in_use_high_water) {
+            task->stats.in_use_high_water = in_use;
+        }
+
+        auto ready = (int) read_buffers.size();
+
+        LARGE_INTEGER start;
+        QueryPerformanceCounter(&start);
+        telemetry_depth(&task->telemetry, start.QuadPart, (int) free_buffers.size(), ready);
+        ReleaseMutex(handle.mutex_buffers);
+
+        if (handle.latency_target_us > 0) {
+            task->chunk = adapt_chunk(task, ready);
+        }
+
+        buffer->result = fill_buffer(task, buffer);
+
+        if (task->replay != NULL && replay_finished(task->replay)) {
             WaitForSingleObject(handle.mutex_buffers, INFINITE);
-            auto& free_buffers = data->free_buffers[handle.handle];
-            auto& read_buffers = data->read_buffers[handle.handle];
-
-            if (free_buffers.size() > 0) {
-                auto buffer = free_buffers.front();
-                free_buffers.pop();
-                ReleaseMutex(handle.mutex_buffers);
-
-                switch (handle.type) {
-                case TASK_TYPE::TASK_TYPE_ANALOG_INPUT:
-                    buffer.result = fill_buffer_analog(handle, &buffer);
-                    break;
-                case TASK_TYPE::TASK_TYPE_DIGITAL_INPUT:
-                    buffer.result = fill_buffer_digital(handle, &buffer);
-                    break;
-                default:
-                    throw std::exception("NILoop: task type not implemented");
+            free_buffers.push(buffer);
+            ReleaseMutex(handle.mutex_buffers);
+            return;
+        }
+
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        telemetry_read(&task->telemetry, (now.QuadPart - start.QuadPart) * 1000000 / data->tick_frequency, buffer->result);
+        buffer->timestamp = now.QuadPart;
+        buffer->first_sample = task->samples_acquired;
+        task->samples_acquired += buffer->samples;
+
+        // the recorder copies the buffer, so it is free to go on
+        // right after this
+        if (task->recorder != NULL && buffer->result >= 0) {
+            task_record(task, buffer);
+        }
+
+        if (task->info.edge_mask != 0) {
+            task_extract_edges(task, buffer);
+        }
+
+        // recordings keep the words, so a replay can unpack other lines
+        if (task->info.unpack_mode != UNPACK_MODE::UNPACK_MODE_NONE && buffer->result >= 0) {
+            task_unpack(task, buffer);
+        }
+
+        // a read shorter than the decimation may not complete an output
+        // sample. The buffer is still queued, with 0 samples, so every
+        // sequence number reaches the consumer and gaps mean lost data
+        if (task->filter != NULL && buffer->result >= 0) {
+            task_filter(task, buffer);
+        }
+
+        if (!task->rings.empty()) {
+            // planar delivery: the buffer was only scratch space for
+            // the read and goes straight back to the free queue. A failed
+            // read is kept for the next read_channel or peek_channel
+            if (buffer->result >= 0) {
+                for (int ch = 0; ch < (int) task->rings.size(); ch++) {
+                    auto channel_data = (const char*) buffer->pData + ch * buffer->stride * task->rings[ch].sample_size;
+                    ring_write(task->rings[ch], channel_data, buffer->samples);
                 }
+            }
+
+            WaitForSingleObject(handle.mutex_buffers, INFINITE);
+            if (buffer->result < 0) {
+                handle.result = (ERR_CODE) buffer->result;
+            }
+            free_buffers.push(buffer);
+            task->stats.filled++;
+            SetEvent(data->any_ready_event);
+            ReleaseMutex(handle.mutex_buffers);
+            return;
+        }
+
+        WaitForSingleObject(handle.mutex_buffers, INFINITE);
+        task_queue(task, buffer);
+        task->stats.filled++;
+        SetEvent(data->any_ready_event);
+        ReleaseMutex(handle.mutex_buffers);
+    } else {
+        // the consumer is behind and the device keeps filling its
+        // FIFO. count it so the pool can be sized from evidence, once
+        // per stall and not once per sleep
+        if (!task->exhausted) {
+            task->stats.overruns++;
+            task->exhausted = true;
+
+            LARGE_INTEGER now;
+            QueryPerformanceCounter(&now);
+            telemetry_depth(&task->telemetry, now.QuadPart, 0, (int) read_buffers.size());
+        }
+        ReleaseMutex(handle.mutex_buffers);
+        telemetry_sleep(&task->telemetry);
+        Sleep(1);
+    }
+}
 
-                WaitForSingleObject(handle.mutex_buffers, INFINITE);
-                read_buffers.push(buffer);
-                ReleaseMutex(handle.mutex_buffers);
+// true once the device generated every sample written to its buffer
+bool output_drained(const handle_info& info) {
+    uInt32 space = 0;
+    uInt32 size = 0;
+    if (DAQmxGetWriteSpaceAvail(info.handle, &space) < 0) return false;
+    if (DAQmxGetBufOutputBufSize(info.handle, &size) < 0) return false;
+    return size > 0 && space >= size;
+}
+
+// Writes the oldest queued buffer of an output task. Before the task runs,
+// the first prefill buffers go into the device buffer and the task is
+// started after them, so generation begins with a full queue behind it
+void poll_output(poll_thread_data* data, task_state* task) {
+    auto& handle = task->info;
+
+    WaitForSingleObject(handle.mutex_buffers, INFINITE);
+    auto& free_buffers = task->free_buffers;
+    auto& read_buffers = task->read_buffers;
+    auto queued = (int) read_buffers.size();
+
+    if (queued == 0 || (task->sequence == 0 && queued < task->prefill)) {
+        // DAQmxWrite blocks while the device buffer is full, so the queue is
+        // empty most of the time. Only a device buffer that played out
+        // completely is an underrun, counted once per gap
+        if (task->output_started && !task->starved && output_drained(handle)) {
+            task->stats.underruns++;
+            task->starved = true;
+        }
+        ReleaseMutex(handle.mutex_buffers);
+        telemetry_sleep(&task->telemetry);
+        Sleep(1);
+        return;
+    }
+
+    auto buffer = read_buffers.front();
+    read_buffers.pop();
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+    telemetry_depth(&task->telemetry, start.QuadPart, (int) free_buffers.size(), (int) read_buffers.size());
+    ReleaseMutex(handle.mutex_buffers);
+
+    switch (handle.type) {
+    case TASK_TYPE::TASK_TYPE_ANALOG_OUTPUT:
+        buffer->result = write_buffer_analog(handle, buffer);
+        break;
+    case TASK_TYPE::TASK_TYPE_DIGITAL_OUTPUT:
+        buffer->result = write_buffer_digital(handle, buffer);
+        break;
+    default:
+        throw std::exception("NILoop: task type not implemented");
+    }
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    telemetry_read(&task->telemetry, (now.QuadPart - start.QuadPart) * 1000000 / data->tick_frequency, buffer->result);
+    buffer->timestamp = now.QuadPart;
+    buffer->sequence = task->sequence++;
+    buffer->first_sample = task->samples_acquired;
+    task->samples_acquired += buffer->samples;
+
+    auto result = buffer->result;
+    if (result >= 0 && !task->output_started && task->sequence >= task->prefill) {
+        result = DAQmxStartTask(handle.handle);
+        task->output_started = result >= 0;
+    }
+
+    WaitForSingleObject(handle.mutex_buffers, INFINITE);
+    // the error ends a gap that may already be counted. The stopped
+    // generation leaves the device buffer drained, which is not counted again
+    if (result == DAQmxErrorGenStoppedToPreventRegenOfOldSamples && !task->starved) {
+        task->stats.underruns++;
+    }
+    task->starved = result == DAQmxErrorGenStoppedToPreventRegenOfOldSamples;
+    if (result < 0) {
+        handle.result = (ERR_CODE) result;
+    }
+    free_buffers.push(buffer);
+    task->stats.filled++;
+    SetEvent(task->ready_event);
+    SetEvent(data->any_ready_event);
+    ReleaseMutex(handle.mutex_buffers);
+}
+
+bool sync_group_replay_finished(sync_group* group) {
+    for (auto task : group->tasks) {
+        if (task->replay != NULL && replay_finished(task->replay)) return true;
+    }
+    return false;
+}
+
+// one pass over a sync group. Either every task gets a buffer or none does,
+// so frames never go out of step
+void poll_sync_group(poll_thread_data* data, sync_group* group) {
+    std::vector<buffer*> buffers;
+
+    // once one recording of the group ran out, no more frames can be
+    // completed
+    if (sync_group_replay_finished(group)) {
+        Sleep(1);
+        return;
+    }
+
+    for (auto task : group->tasks) {
+        WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+        if (task->free_buffers.size() > 0 || task_grow(task)) {
+            buffers.push_back(task->free_buffers.front());
+            task->free_buffers.pop();
+            ReleaseMutex(task->info.mutex_buffers);
+        } else {
+            ReleaseMutex(task->info.mutex_buffers);
+            break;
+        }
+    }
+
+    if (buffers.size() < group->tasks.size()) {
+        for (int i = 0; i < (int) group->tasks.size(); i++) {
+            auto task = group->tasks[i];
+            WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+            if (i < (int) buffers.size()) {
+                task->free_buffers.push(buffers[i]);
+            }
+            if (!task->exhausted) {
+                task->stats.overruns++;
+                task->exhausted = true;
+
+                LARGE_INTEGER now;
+                QueryPerformanceCounter(&now);
+                telemetry_depth(&task->telemetry, now.QuadPart, (int) task->free_buffers.size(), (int) task->read_buffers.size());
+            }
+            ReleaseMutex(task->info.mutex_buffers);
+            telemetry_sleep(&task->telemetry);
+        }
+        Sleep(1);
+        return;
+    }
+
+    for (auto task : group->tasks) {
+        task->exhausted = false;
+    }
+
+    // the reads return together since the tasks share a clock. The frame is
+    // stamped when the last one returned
+    for (int i = 0; i < (int) group->tasks.size(); i++) {
+        auto task = group->tasks[i];
+
+        LARGE_INTEGER start, end;
+        QueryPerformanceCounter(&start);
+        buffers[i]->result = fill_buffer(task, buffers[i]);
+        QueryPerformanceCounter(&end);
+        telemetry_read(&task->telemetry, (end.QuadPart - start.QuadPart) * 1000000 / data->tick_frequency, buffers[i]->result);
+    }
+
+    if (sync_group_replay_finished(group)) {
+        for (int i = 0; i < (int) group->tasks.size(); i++) {
+            auto task = group->tasks[i];
+            WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+            task->free_buffers.push(buffers[i]);
+            ReleaseMutex(task->info.mutex_buffers);
+        }
+        return;
+    }
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    WaitForSingleObject(group->mutex_frames, INFINITE);
+    sync_frame* frame;
+    if (group->free_frames.size() > 0) {
+        frame = group->free_frames.front();
+        group->free_frames.pop();
+    } else {
+        frame = new sync_frame();
+    }
+    ReleaseMutex(group->mutex_frames);
+
+    frame->sequence = group->sequence++;
+    frame->buffers = buffers;
+
+    for (int i = 0; i < (int) group->tasks.size(); i++) {
+        auto task = group->tasks[i];
+        auto buf = buffers[i];
+
+        buf->timestamp = now.QuadPart;
+        buf->sequence = frame->sequence;
+        buf->first_sample = task->samples_acquired;
+        task->samples_acquired += buf->samples;
+        task->sequence++;
+
+        if (task->recorder != NULL && buf->result >= 0) {
+            task_record(task, buf);
+        }
+
+        if (task->info.edge_mask != 0) {
+            task_extract_edges(task, buf);
+        }
+
+        if (task->info.unpack_mode != UNPACK_MODE::UNPACK_MODE_NONE && buf->result >= 0) {
+            task_unpack(task, buf);
+        }
+
+        if (task->filter != NULL && buf->result >= 0) {
+            task_filter(task, buf);
+        }
+
+        WaitForSingleObject(task->info.mutex_buffers, INFINITE);
+        task->stats.filled++;
+        ReleaseMutex(task->info.mutex_buffers);
+    }
+
+    WaitForSingleObject(group->mutex_frames, INFINITE);
+    group->frames.push(frame);
+    SetEvent(group->ready_event);
+    SetEvent(data->any_ready_event);
+    ReleaseMutex(group->mutex_frames);
+}
+
+DWORD WINAPI PollThread(LPVOID pthread) {
+    auto thread = (poll_thread*) pthread;
+    auto data = thread->parent;
+    auto hMmcss = apply_thread_settings(thread);
+
+    while (!data->stop) {
+        for (auto task : thread->tasks) {
+            if (is_output(task->info)) {
+                poll_output(data, task);
             } else {
-                ReleaseMutex(handle.mutex_buffers);
-                Sleep(1);
+                poll_input(data, task);
             }
         }
+
+        for (auto group : thread->sync_groups) {
+            poll_sync_group(data, group);
+        }
     }
 
-    SetEvent(data->hThreadEndEvent);
+    if (hMmcss != NULL) AvRevertMmThreadCharacteristics(hMmcss);
     return 0;
-}
\ No newline at end of file
+}
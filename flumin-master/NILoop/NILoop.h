@@ -1,3 +1,5 @@
+#pragma once
+
 // The following ifdef block is the standard way of creating macros which make exporting 
 // from a DLL simpler. All files within this DLL are compiled with the NILOOP_EXPORTS
 // symbol defined on the command line. This symbol should not be defined on any project
@@ -12,3 +14,171 @@
 
 #include <NIDAQmx.h>
 
+// Types and exports shared by NILoop.cpp and the native consumers of the
+// DLL. DeviceLibrary/NILoop.cs mirrors them for the managed side
+
+struct poll_thread_data;
+struct telemetry_stats;
+struct depth_sample;
+struct disk_writer_stats;
+struct digital_event;
+
+enum ERR_CODE {
+    ERR_CODE_SUCCESS = 0,
+    ERR_CODE_READ_FAILED = -1
+};
+
+enum TASK_TYPE {
+    TASK_TYPE_ANALOG_INPUT = 0,
+    TASK_TYPE_DIGITAL_INPUT,
+    // output tasks run the queues the other way around: the consumer takes a
+    // free buffer with acquire_write_buffer, fills it and queues it with
+    // submit_write_buffer. The loop writes queued buffers to the device
+    TASK_TYPE_ANALOG_OUTPUT,
+    TASK_TYPE_DIGITAL_OUTPUT
+};
+
+enum TASK_FLAG {
+    TASK_FLAG_NONE         = 0,
+    // allocate all buffers of the task from one page locked block of memory.
+    // the consumer can query it with get_arena and wrap it once instead of
+    // copying every buffer
+    TASK_FLAG_SHARED_ARENA = 1,
+    // deliver the samples of every channel into a ring of its own instead of
+    // queueing whole buffers. Consumers read them with read_channel or
+    // peek_channel/consume_channel
+    TASK_FLAG_PLANAR       = 2
+};
+
+enum SAMPLE_FORMAT {
+    SAMPLE_FORMAT_DEFAULT = 0,  // float64 for analog, uInt32 for digital tasks
+    // analog only: unscaled int16 ADC codes. A quarter of the memory traffic
+    // of float64, scaled on demand with read_buffer_scaled
+    SAMPLE_FORMAT_RAW_I16
+};
+
+enum READER_PRIORITY {
+    READER_PRIORITY_DEFAULT = 0,
+    READER_PRIORITY_HIGH,
+    READER_PRIORITY_REALTIME,
+    // register with the multimedia class scheduler as "Pro Audio". MMCSS
+    // boosts the thread into the realtime range without starving the system
+    READER_PRIORITY_MMCSS
+};
+
+// thread_group of a task
+const int THREAD_GROUP_SHARED = 0;  // the common polling thread
+const int THREAD_GROUP_OWN    = -1; // a reader thread only for this task
+                                    // any other value: one thread per group, e.g. per device
+
+struct handle_info {
+    TaskHandle  handle;
+    TASK_TYPE   type;
+    int         samples_per_chan;
+    int         buffer_size;
+    HANDLE      mutex_buffers;
+    ERR_CODE    result;
+    int         flags;
+    int         pool_depth;     // buffers allocated at start, 0 for POOL_SIZE
+    int         pool_max_bytes; // the pool may grow up to this many bytes, 0 for a fixed pool
+    int         thread_group;
+    unsigned    affinity_mask;  // cpus the reader thread may run on, 0 for any
+    int         thread_priority;
+    int         sample_format;
+    int         ring_samples;   // capacity of each channel ring with TASK_FLAG_PLANAR, 0 for as much as the pool can hold
+    const wchar_t* record_path; // every filled buffer is also written to this file, NULL to not record
+    int         record_prealloc_mb;
+    int         prefill_buffers;    // output only: buffers queued before the task is started, 0 for 2
+    const wchar_t* replay_path; // input only: read the buffers from this recording instead of the device
+    int         replay_mode;
+    int         replay_loop;    // start over at the end of the recording instead of going quiet
+    int         sync_group;     // tasks with the same non zero group are read in lockstep and delivered as frames. Not with TASK_FLAG_PLANAR or readers
+    int         latency_target_us;  // hardware input only, ignored for replays: adapt the read size to this latency, 0 to always read samples_per_chan
+    int         chunk_min;          // smallest adaptive read, 0 for samples_per_chan / 16
+    int         unpack_mode;    // digital input only: deliver the lines in line_mask as separate streams
+    unsigned    line_mask;
+    unsigned    edge_mask;      // digital input only: edges of these lines are queued as events, read with read_events
+    int         event_capacity; // events the queue holds, 0 for EVENT_CAPACITY
+    int         decimation;     // analog input only: low-pass filter and keep every n-th sample before queueing, 0 or 1 for all. Reads that complete no output sample are queued with 0 samples
+    const double* filter_coeffs;    // FIR run before decimating, NULL for a designed low-pass
+    int         filter_taps;        // length of filter_coeffs, or of the designed low-pass with 0 for 16 * decimation + 1
+
+    bool const operator == (const handle_info &o) const { return o.handle == handle; }
+    //bool const operator <  (const handle_info &o) const { return o.handle < handle;  }
+};
+
+// handed to the consumer by acquire_buffer. pData stays valid until the
+// lease is given back with release_buffer
+struct buffer_lease {
+    int       id;
+    void*     pData;
+    int       len;
+    int       offset;
+    long long sequence;
+    long long timestamp;
+    long long first_sample;
+    int       samples;
+    int       stride;       // distance between the channels in samples. Between the line streams in bytes for unpacked digital tasks
+};
+
+// the readable part of a ring, split in two where it wraps around
+struct channel_view {
+    void*     first;
+    int       first_samples;
+    void*     second;
+    int       second_samples;
+    long long position;             // sample index of the first sample in first
+};
+
+struct pool_stats {
+    int       depth;        // buffers currently in circulation
+    int       max_depth;    // buffers the pool may grow to
+    int       free;
+    int       ready;
+    int       in_use_high_water;
+    int       grow_count;
+    long long overruns;     // times the loop found no free buffer and could not grow
+    long long filled;
+    long long underruns;    // output only: times the device buffer played out with no buffer queued
+    int       chunk;        // samples per channel of the next read
+};
+
+extern "C" {
+    NILOOP_API poll_thread_data* start_polling(handle_info* handles, int handleCount);
+    NILOOP_API void stop_polling(poll_thread_data* data);
+    NILOOP_API int acquire_buffer(poll_thread_data* data, TaskHandle handle, buffer_lease* lease);
+    NILOOP_API int wait_buffer(poll_thread_data* data, TaskHandle handle, int timeout_ms);
+    NILOOP_API int wait_any_buffer(poll_thread_data* data, int timeout_ms);
+    NILOOP_API HANDLE get_ready_event(poll_thread_data* data, TaskHandle handle);
+    NILOOP_API HANDLE get_any_ready_event(poll_thread_data* data);
+    NILOOP_API int acquire_buffer_wait(poll_thread_data* data, TaskHandle handle, buffer_lease* lease, int timeout_ms);
+    NILOOP_API int release_buffer(poll_thread_data* data, TaskHandle handle, int id);
+    NILOOP_API int acquire_write_buffer(poll_thread_data* data, TaskHandle handle, buffer_lease* lease);
+    NILOOP_API int submit_write_buffer(poll_thread_data* data, TaskHandle handle, int id, int samples);
+    NILOOP_API int register_reader(poll_thread_data* data, TaskHandle handle);
+    NILOOP_API int unregister_reader(poll_thread_data* data, TaskHandle handle, int reader_id);
+    NILOOP_API int acquire_reader_buffer(poll_thread_data* data, TaskHandle handle, int reader_id, buffer_lease* lease);
+    NILOOP_API int release_reader_buffer(poll_thread_data* data, TaskHandle handle, int reader_id, int id);
+    NILOOP_API int wait_reader(poll_thread_data* data, TaskHandle handle, int reader_id, int timeout_ms);
+    NILOOP_API int get_arena(poll_thread_data* data, TaskHandle handle, void** base, int* size);
+    NILOOP_API int get_pool_stats(poll_thread_data* data, TaskHandle handle, pool_stats* stats);
+    NILOOP_API int read_buffer(poll_thread_data* data, TaskHandle task, void* dest, int size);
+    NILOOP_API int read_buffer_wait(poll_thread_data* data, TaskHandle task, void* dest, int size, int timeout_ms);
+    NILOOP_API int read_buffer_info(poll_thread_data* data, TaskHandle task, void* dest, int size, int timeout_ms, buffer_lease* info);
+    NILOOP_API int wait_frame(poll_thread_data* data, int group_id, int timeout_ms);
+    NILOOP_API int acquire_frame(poll_thread_data* data, int group_id, buffer_lease* leases, int max_leases);
+    NILOOP_API int release_frame(poll_thread_data* data, int group_id, const buffer_lease* leases, int count);
+    NILOOP_API int read_channel(poll_thread_data* data, TaskHandle handle, int channel, void* dest, int max_samples, int* read);
+    NILOOP_API int peek_channel(poll_thread_data* data, TaskHandle handle, int channel, channel_view* view);
+    NILOOP_API int consume_channel(poll_thread_data* data, TaskHandle handle, int channel, int samples);
+    NILOOP_API long long get_channel_dropped(poll_thread_data* data, TaskHandle handle, int channel);
+    NILOOP_API int read_events(poll_thread_data* data, TaskHandle handle, digital_event* dest, int max_events, int* read);
+    NILOOP_API long long get_events_dropped(poll_thread_data* data, TaskHandle handle);
+    NILOOP_API int get_scaling_coeffs(poll_thread_data* data, TaskHandle handle, double* coeffs, int size);
+    NILOOP_API void scale_raw(const short* src, double* dst, int samples_per_chan, int channels, const double* coeffs, int coeff_count);
+    NILOOP_API int read_buffer_scaled(poll_thread_data* data, TaskHandle handle, double* dest, int size, int timeout_ms, buffer_lease* info);
+    NILOOP_API int get_telemetry(poll_thread_data* data, TaskHandle handle, telemetry_stats* stats);
+    NILOOP_API int get_depth_history(poll_thread_data* data, TaskHandle handle, depth_sample* dest, int max_samples);
+    NILOOP_API int get_recording_stats(poll_thread_data* data, TaskHandle handle, disk_writer_stats* stats);
+    NILOOP_API long long get_timestamp_frequency();
+}
@@ -0,0 +1,157 @@
+#include "stdafx.h"
+#include "Replay.h"
+
+struct replay_source {
+    HANDLE    hFile;
+    int       mode;
+    bool      loop;
+    bool      finished;
+    bool      broken;               // a record header made the rest of the file unreadable
+    long long data_start;           // file offset of the first record
+    long long file_frequency;
+    long long frequency;
+    long long first_timestamp;      // of the first record in the file
+    long long start;                // QueryPerformanceCounter when the first record was delivered
+    long long loop_offset;          // recording ticks of the passes already played
+    long long last_timestamp;
+    long long interval;             // between the last two records, also used between two passes
+};
+
+bool read_exact(HANDLE hFile, void* dest, int len) {
+    DWORD read = 0;
+    return ReadFile(hFile, dest, len, &read, NULL) && read == (DWORD) len;
+}
+
+replay_source* replay_open(const wchar_t* path, int mode, bool loop, record_file_header* header, std::vector<double>* scaling) {
+    auto hFile = CreateFileW(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        NULL
+    );
+
+    if (hFile == INVALID_HANDLE_VALUE) return NULL;
+
+    if (!read_exact(hFile, header, sizeof(*header)) ||
+        memcmp(header->magic, "NIRC", 4) != 0 ||
+        header->version != RECORD_VERSION ||
+        header->scaling_count < 0) {
+        CloseHandle(hFile);
+        return NULL;
+    }
+
+    scaling->assign(header->scaling_count, 0.0);
+    if (header->scaling_count > 0 && !read_exact(hFile, &(*scaling)[0], header->scaling_count * sizeof(double))) {
+        CloseHandle(hFile);
+        return NULL;
+    }
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+
+    auto src = new replay_source();
+    src->hFile = hFile;
+    src->mode = mode;
+    src->loop = loop;
+    src->finished = false;
+    src->broken = false;
+    src->data_start = sizeof(*header) + header->scaling_count * sizeof(double);
+    src->file_frequency = (header->timestamp_frequency > 0) ? header->timestamp_frequency : freq.QuadPart;
+    src->frequency = freq.QuadPart;
+    src->first_timestamp = -1;
+    src->start = 0;
+    src->loop_offset = 0;
+    src->last_timestamp = 0;
+    src->interval = 0;
+
+    return src;
+}
+
+// waits until the record is due relative to the first one
+void replay_pace(replay_source* src, long long timestamp) {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    if (src->first_timestamp < 0) {
+        src->first_timestamp = timestamp;
+        src->start = now.QuadPart;
+        return;
+    }
+
+    auto elapsed = timestamp - src->first_timestamp + src->loop_offset;
+    auto due = src->start + elapsed * src->frequency / src->file_frequency;
+    auto wait_ms = (due - now.QuadPart) * 1000 / src->frequency;
+
+    if (wait_ms > 0) Sleep((DWORD) wait_ms);
+}
+
+int replay_read(replay_source* src, void* dest, int size, int* samples, int* stride) {
+    record_header header;
+
+    if (src->broken) src->finished = true;
+    if (src->finished) return 1;
+
+    if (!read_exact(src->hFile, &header, sizeof(header))) {
+        if (!src->loop) {
+            src->finished = true;
+            return 1;
+        }
+
+        // start over. The next pass continues the timeline of this one,
+        // one record interval after its last record
+        LARGE_INTEGER pos;
+        pos.QuadPart = src->data_start;
+        SetFilePointerEx(src->hFile, pos, NULL, FILE_BEGIN);
+        src->loop_offset += src->last_timestamp - src->first_timestamp + src->interval;
+        src->last_timestamp = src->first_timestamp;
+
+        if (!read_exact(src->hFile, &header, sizeof(header))) {
+            src->finished = true;
+            return 1;
+        }
+    }
+
+    if (header.len < 0) {
+        // the next record can't be found any more. Report it once, then end
+        src->broken = true;
+        return -1;
+    }
+
+    if (header.len > size) {
+        // skip the payload, so the next read starts at the next record
+        LARGE_INTEGER skip;
+        skip.QuadPart = header.len;
+        if (!SetFilePointerEx(src->hFile, skip, NULL, FILE_CURRENT)) {
+            src->broken = true;
+        }
+        return -1;
+    }
+
+    if (!read_exact(src->hFile, dest, header.len)) return -1;
+
+    if (src->first_timestamp >= 0 && header.timestamp > src->last_timestamp) {
+        src->interval = header.timestamp - src->last_timestamp;
+    }
+
+    if (src->mode == REPLAY_MODE::REPLAY_MODE_REALTIME) {
+        replay_pace(src, header.timestamp);
+    }
+
+    src->last_timestamp = header.timestamp;
+    *samples = header.samples;
+    *stride = header.stride;
+
+    return 0;
+}
+
+bool replay_finished(replay_source* src) {
+    return src->finished;
+}
+
+void replay_close(replay_source* src) {
+    CloseHandle(src->hFile);
+    delete src;
+}
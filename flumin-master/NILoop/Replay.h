@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+
+// Layout of the files the recorder writes: one record_file_header, the
+// scaling coefficients of a raw task (scaling_count doubles) and then a
+// record_header followed by the raw buffer for every buffer the task read.
+
+const int RECORD_VERSION = 3;
+
+struct record_file_header {
+    char      magic[4];             // "NIRC"
+    int       version;
+    int       type;
+    int       sample_format;
+    int       samples_per_chan;
+    int       buffer_size;
+    int       channels;
+    int       scaling_count;
+    long long timestamp_frequency;
+};
+
+struct record_header {
+    long long sequence;
+    long long timestamp;
+    long long first_sample;
+    int       samples;
+    int       stride;
+    int       len;
+};
+
+enum REPLAY_MODE {
+    REPLAY_MODE_REALTIME = 0,   // deliver the buffers with the spacing they were recorded with
+    REPLAY_MODE_FAST            // deliver them as fast as the consumer takes them
+};
+
+// Plays a recording back in place of DAQmx reads
+struct replay_source;
+
+// NULL if the file can't be opened or is not a recording
+replay_source* replay_open(const wchar_t* path, int mode, bool loop, record_file_header* header, std::vector<double>* scaling);
+
+// copies the next record to dest. Returns 0, a negative value if the file is
+// broken or the record does not fit and 1 once the end was reached without loop.
+// A record that does not fit is skipped, a broken file ends the replay
+int replay_read(replay_source* src, void* dest, int size, int* samples, int* stride);
+
+bool replay_finished(replay_source* src);
+
+void replay_close(replay_source* src);
@@ -0,0 +1,47 @@
+#include "stdafx.h"
+#include <emmintrin.h>
+#include "Scaling.h"
+
+// SSE2 is the baseline of every CPU DAQmx supports, so there is no runtime
+// dispatch. Four samples are converted per iteration, two per register.
+void scale_i16(const short* src, double* dst, int count, const double* coeffs, int coeff_count) {
+    if (coeff_count <= 0) {
+        for (int i = 0; i < count; i++) dst[i] = 0.0;
+        return;
+    }
+
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        // sign extend four int16 to int32 by placing them in the high halves
+        auto raw  = _mm_loadl_epi64((const __m128i*) (src + i));
+        auto wide = _mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16);
+
+        auto x0 = _mm_cvtepi32_pd(wide);
+        auto x1 = _mm_cvtepi32_pd(_mm_shuffle_epi32(wide, _MM_SHUFFLE(1, 0, 3, 2)));
+
+        // horner scheme, highest order coefficient first
+        auto acc0 = _mm_set1_pd(coeffs[coeff_count - 1]);
+        auto acc1 = acc0;
+
+        for (int k = coeff_count - 2; k >= 0; k--) {
+            auto c = _mm_set1_pd(coeffs[k]);
+            acc0 = _mm_add_pd(_mm_mul_pd(acc0, x0), c);
+            acc1 = _mm_add_pd(_mm_mul_pd(acc1, x1), c);
+        }
+
+        _mm_storeu_pd(dst + i, acc0);
+        _mm_storeu_pd(dst + i + 2, acc1);
+    }
+
+    for (; i < count; i++) {
+        double x = src[i];
+        double acc = coeffs[coeff_count - 1];
+
+        for (int k = coeff_count - 2; k >= 0; k--) {
+            acc = acc * x + coeffs[k];
+        }
+
+        dst[i] = acc;
+    }
+}
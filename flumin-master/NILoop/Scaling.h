@@ -0,0 +1,6 @@
+#pragma once
+
+// Converts count raw ADC codes to doubles with the polynomial
+// coeffs[0] + coeffs[1] * x + coeffs[2] * x^2 + ... (coeff_count terms),
+// the form DAQmx reports with DAQmxGetAIDevScalingCoeff.
+void scale_i16(const short* src, double* dst, int count, const double* coeffs, int coeff_count);
@@ -0,0 +1,97 @@
+#include "stdafx.h"
+#include "Telemetry.h"
+
+void telemetry_reset(task_telemetry* t) {
+    memset((void*) t, 0, sizeof(task_telemetry));
+}
+
+int latency_bucket(long long microseconds) {
+    int bucket = 0;
+    while (microseconds > 0 && bucket < LATENCY_BUCKETS - 1) {
+        microseconds >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void telemetry_read(task_telemetry* t, long long microseconds, int result) {
+    InterlockedIncrement64(&t->read_histogram[latency_bucket(microseconds)]);
+    InterlockedIncrement64(&t->reads);
+    InterlockedExchangeAdd64(&t->read_us_total, microseconds);
+    if (microseconds > t->read_us_max) {
+        InterlockedExchange64(&t->read_us_max, microseconds);
+    }
+
+    if (result == 0) return;
+
+    // only the reader thread of the task adds codes, so claiming a free
+    // entry can't race with another writer
+    for (int i = 0; i < MAX_ERROR_CODES; i++) {
+        if (t->error_codes[i] == 0) {
+            InterlockedExchange(&t->error_codes[i], result);
+        }
+        if (t->error_codes[i] == result) {
+            InterlockedIncrement64(&t->error_counts[i]);
+            return;
+        }
+    }
+
+    InterlockedIncrement64(&t->other_errors);
+}
+
+void telemetry_sleep(task_telemetry* t) {
+    InterlockedIncrement64(&t->sleeps);
+}
+
+void telemetry_depth(task_telemetry* t, long long timestamp, int free, int ready) {
+    auto& sample = t->depth_history[t->depth_pos % DEPTH_HISTORY];
+    sample.timestamp = timestamp;
+    sample.free = free;
+    sample.ready = ready;
+
+    // publish the sample only after it has been written
+    InterlockedExchange64(&t->depth_pos, t->depth_pos + 1);
+}
+
+long long read64(volatile long long* value) {
+    return InterlockedCompareExchange64(value, 0, 0);
+}
+
+void telemetry_snapshot(task_telemetry* t, telemetry_stats* stats) {
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        stats->read_histogram[i] = read64(&t->read_histogram[i]);
+    }
+
+    stats->reads = read64(&t->reads);
+    stats->read_us_total = read64(&t->read_us_total);
+    stats->read_us_max = read64(&t->read_us_max);
+    stats->sleeps = read64(&t->sleeps);
+
+    for (int i = 0; i < MAX_ERROR_CODES; i++) {
+        stats->error_codes[i] = t->error_codes[i];
+        stats->error_counts[i] = read64(&t->error_counts[i]);
+    }
+
+    stats->other_errors = read64(&t->other_errors);
+}
+
+int telemetry_depth_history(task_telemetry* t, depth_sample* dest, int max_samples) {
+    auto end = read64(&t->depth_pos);
+    auto count = (int) min((long long) min(max_samples, DEPTH_HISTORY), end);
+    auto start = end - count;
+
+    for (int i = 0; i < count; i++) {
+        dest[i] = t->depth_history[(start + i) % DEPTH_HISTORY];
+    }
+
+    // the writer may have overwritten the oldest samples while they were
+    // copied. Only the ones it could not have reached are kept
+    auto oldest_intact = read64(&t->depth_pos) - DEPTH_HISTORY + 1;
+    auto skip = (int) max(0LL, min((long long) count, oldest_intact - start));
+
+    if (skip > 0) {
+        memmove(dest, dest + skip, (count - skip) * sizeof(depth_sample));
+    }
+
+    return count - skip;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// Counters of one task, written only by its reader thread and read by anyone
+// without taking a lock. Cheap enough to stay on all the time.
+
+const int LATENCY_BUCKETS  = 24;    // bucket i counts reads that took [2^(i-1), 2^i) microseconds, bucket 0 under 1 us
+const int DEPTH_HISTORY    = 256;
+const int MAX_ERROR_CODES  = 16;
+
+// free and ready queue depth of a task at the moment the loop took a buffer,
+// or found none free. Overruns are counted in pool_stats
+struct depth_sample {
+    long long timestamp;
+    int       free;
+    int       ready;
+};
+
+struct task_telemetry {
+    volatile long long read_histogram[LATENCY_BUCKETS];
+    volatile long long reads;
+    volatile long long read_us_total;
+    volatile long long read_us_max;
+    volatile long long sleeps;                      // Sleep(1)s while starved. Grows with the stall length, overruns count stalls
+    volatile LONG      error_codes[MAX_ERROR_CODES];
+    volatile long long error_counts[MAX_ERROR_CODES];
+    volatile long long other_errors;                // codes that did not fit into the table
+    depth_sample       depth_history[DEPTH_HISTORY];
+    volatile long long depth_pos;
+};
+
+// the consistent copy handed to consumers
+struct telemetry_stats {
+    long long read_histogram[LATENCY_BUCKETS];
+    long long reads;
+    long long read_us_total;
+    long long read_us_max;
+    long long sleeps;
+    int       error_codes[MAX_ERROR_CODES];         // 0 marks an unused entry
+    long long error_counts[MAX_ERROR_CODES];
+    long long other_errors;
+};
+
+void telemetry_reset(task_telemetry* t);
+
+void telemetry_read(task_telemetry* t, long long microseconds, int result);
+
+void telemetry_sleep(task_telemetry* t);
+
+void telemetry_depth(task_telemetry* t, long long timestamp, int free, int ready);
+
+void telemetry_snapshot(task_telemetry* t, telemetry_stats* stats);
+
+// copies up to max_samples of the most recent depth samples to dest, oldest
+// first, and returns how many were copied
+int telemetry_depth_history(task_telemetry* t, depth_sample* dest, int max_samples);
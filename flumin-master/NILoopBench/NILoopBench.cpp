@@ -0,0 +1,382 @@
+// NILoopBench.cpp : drives NILoop with simulated tasks and reports throughput,
+// consumer latency and overruns as JSON.
+//
+// The tasks replay a generated recording in realtime, so no NI driver or
+// device is needed. The loop threads, buffer pool and handoff to the consumer
+// are the ones hardware tasks use, but the reads go through replay_read and
+// not DAQmx: read_us_max includes the replay's pacing sleep and says nothing
+// about driver read times. Adaptive read sizes (latency_target_us) are not
+// available, a replay delivers its records as recorded.
+// A single consumer thread takes the buffers the way NidaqSession does.
+
+#include "stdafx.h"
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <mmsystem.h>
+#include "../NILoop/NILoop.h"
+#include "../NILoop/Telemetry.h"
+#include "../NILoop/Replay.h"
+
+const int REPLAY_PASS_SECONDS = 2;
+
+struct bench_config {
+    int         tasks;
+    int         channels;
+    double      rate;
+    int         chunk;
+    double      seconds;
+    double      warmup_seconds;
+    int         sample_format;
+    int         thread_group;
+    int         pool_depth;
+    int         work_us;            // the consumer spins this long per buffer
+    bool        touch;              // the consumer reads every sample of a buffer
+    std::string out_path;
+};
+
+struct task_result {
+    long long buffers;
+    long long samples;              // per channel
+    long long gaps;                 // sequence numbers that never reached the consumer
+    long long last_sequence;
+    long long anchor;               // QPC the task's first sample was due, from its first buffer
+    pool_stats pool;
+    telemetry_stats telemetry;
+};
+
+void usage() {
+    fprintf(stderr,
+        "NILoopBench [options]\n"
+        "  --tasks N             simulated input tasks (4)\n"
+        "  --channels N          channels per task (8)\n"
+        "  --rate HZ             samples per second and channel (100000)\n"
+        "  --chunk N             samples per channel and read (1000)\n"
+        "  --seconds S           measured duration (10)\n"
+        "  --warmup S            leading seconds left out of the latency (1)\n"
+        "  --format f64|i16      sample format of the tasks (f64)\n"
+        "  --threads shared|own  one loop thread for all tasks or one per task (shared)\n"
+        "  --pool N              buffers per task, 0 for the default (0)\n"
+        "  --work US             consumer work per buffer (0)\n"
+        "  --touch               consumer reads every sample\n"
+        "  --out PATH            write the JSON there instead of stdout\n");
+}
+
+bool parse_args(int argc, char* argv[], bench_config* config) {
+    config->tasks = 4;
+    config->channels = 8;
+    config->rate = 100000;
+    config->chunk = 1000;
+    config->seconds = 10;
+    config->warmup_seconds = 1;
+    config->sample_format = SAMPLE_FORMAT_DEFAULT;
+    config->thread_group = THREAD_GROUP_SHARED;
+    config->pool_depth = 0;
+    config->work_us = 0;
+    config->touch = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (arg == "--touch") {
+            config->touch = true;
+            continue;
+        }
+        if (value == NULL) return false;
+        i++;
+
+        if (arg == "--tasks")                config->tasks = atoi(value);
+        else if (arg == "--channels")        config->channels = atoi(value);
+        else if (arg == "--rate")            config->rate = atof(value);
+        else if (arg == "--chunk")           config->chunk = atoi(value);
+        else if (arg == "--seconds")         config->seconds = atof(value);
+        else if (arg == "--warmup")          config->warmup_seconds = atof(value);
+        else if (arg == "--format")          config->sample_format = (strcmp(value, "i16") == 0) ? SAMPLE_FORMAT_RAW_I16 : SAMPLE_FORMAT_DEFAULT;
+        else if (arg == "--threads")         config->thread_group = (strcmp(value, "own") == 0) ? THREAD_GROUP_OWN : THREAD_GROUP_SHARED;
+        else if (arg == "--pool")            config->pool_depth = atoi(value);
+        else if (arg == "--work")            config->work_us = atoi(value);
+        else if (arg == "--out")             config->out_path = value;
+        else return false;
+    }
+
+    return config->tasks > 0 && config->channels > 0 && config->rate > 0 && config->chunk > 0 && config->seconds > 0;
+}
+
+// writes REPLAY_PASS_SECONDS of a sine per channel as a recording whose
+// records are spaced like reads of chunk samples at rate would be
+bool write_source(const wchar_t* path, const bench_config& config) {
+    auto hFile = CreateFileW(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+
+    auto raw = config.sample_format == SAMPLE_FORMAT_RAW_I16;
+    auto sample_size = raw ? 2 : 8;
+
+    record_file_header header;
+    memcpy(header.magic, "NIRC", 4);
+    header.version = RECORD_VERSION;
+    header.type = TASK_TYPE_ANALOG_INPUT;
+    header.sample_format = config.sample_format;
+    header.samples_per_chan = config.chunk;
+    header.buffer_size = config.chunk * config.channels;
+    header.channels = config.channels;
+    header.scaling_count = raw ? config.channels * 4 : 0;
+    header.timestamp_frequency = freq.QuadPart;
+
+    // 16 bit codes over +-10 V
+    std::vector<double> scaling(header.scaling_count, 0.0);
+    for (int ch = 0; raw && ch < config.channels; ch++) {
+        scaling[ch * 4 + 1] = 10.0 / 32768;
+    }
+
+    DWORD written;
+    auto ok = WriteFile(hFile, &header, sizeof(header), &written, NULL) != FALSE;
+    if (ok && !scaling.empty()) {
+        ok = WriteFile(hFile, &scaling[0], (DWORD) (scaling.size() * sizeof(double)), &written, NULL) != FALSE;
+    }
+
+    auto records = max(1, (int) (REPLAY_PASS_SECONDS * config.rate / config.chunk));
+    std::vector<char> data(config.chunk * config.channels * sample_size);
+
+    for (int r = 0; ok && r < records; r++) {
+        auto first_sample = (long long) r * config.chunk;
+
+        for (int ch = 0; ch < config.channels; ch++) {
+            for (int i = 0; i < config.chunk; i++) {
+                auto value = sin((first_sample + i) * 6.283185307179586 * (ch + 1) * 10 / config.rate);
+                if (raw) {
+                    ((short*) &data[0])[ch * config.chunk + i] = (short) (value * 30000);
+                } else {
+                    ((double*) &data[0])[ch * config.chunk + i] = value;
+                }
+            }
+        }
+
+        record_header rec;
+        rec.sequence = r;
+        rec.timestamp = (long long) ((first_sample + config.chunk) * freq.QuadPart / config.rate);
+        rec.first_sample = first_sample;
+        rec.samples = config.chunk;
+        rec.stride = config.chunk;
+        rec.len = (int) data.size();
+
+        ok = WriteFile(hFile, &rec, sizeof(rec), &written, NULL) &&
+             WriteFile(hFile, &data[0], rec.len, &written, NULL);
+    }
+
+    CloseHandle(hFile);
+    return ok;
+}
+
+void spin_us(int us, long long frequency) {
+    LARGE_INTEGER start, now;
+    QueryPerformanceCounter(&start);
+    do {
+        QueryPerformanceCounter(&now);
+    } while ((now.QuadPart - start.QuadPart) * 1000000 / frequency < us);
+}
+
+double touch_samples(const buffer_lease& lease, int channels, int sample_format) {
+    double sum = 0;
+    for (int ch = 0; ch < channels; ch++) {
+        for (int i = 0; i < lease.samples; i++) {
+            sum += (sample_format == SAMPLE_FORMAT_RAW_I16)
+                ? ((const short*) lease.pData)[ch * lease.stride + i]
+                : ((const double*) lease.pData)[ch * lease.stride + i];
+        }
+    }
+    return sum;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    auto index = (size_t) (p * (sorted.size() - 1) + 0.5);
+    return sorted[min(index, sorted.size() - 1)];
+}
+
+void write_latency(FILE* out, const char* name, std::vector<double>& values) {
+    std::sort(values.begin(), values.end());
+
+    double sum = 0;
+    for (auto v : values) sum += v;
+
+    fprintf(out, "  \"%s\": { \"count\": %u, \"mean\": %.1f, \"p50\": %.1f, \"p99\": %.1f, \"p99_9\": %.1f, \"max\": %.1f },\n",
+        name,
+        (unsigned) values.size(),
+        values.empty() ? 0.0 : sum / values.size(),
+        percentile(values, 0.5),
+        percentile(values, 0.99),
+        percentile(values, 0.999),
+        values.empty() ? 0.0 : values.back());
+}
+
+int main(int argc, char* argv[]) {
+    bench_config config;
+    if (!parse_args(argc, argv, &config)) {
+        usage();
+        return 1;
+    }
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+
+    wchar_t path[MAX_PATH];
+    GetTempPathW(MAX_PATH, path);
+    wcscat_s(path, L"niloopbench.nirc");
+
+    if (!write_source(path, config)) {
+        fprintf(stderr, "NILoopBench: can't write the simulated source to the temp directory\n");
+        return 2;
+    }
+
+    // Sleep in the loop and in the replay pacing rounds to the timer period
+    timeBeginPeriod(1);
+
+    std::vector<handle_info> handles(config.tasks);
+    for (int t = 0; t < config.tasks; t++) {
+        auto& info = handles[t];
+        memset(&info, 0, sizeof(info));
+        info.handle = (void*) (INT_PTR) (t + 1);
+        info.type = TASK_TYPE_ANALOG_INPUT;
+        info.samples_per_chan = config.chunk;
+        info.buffer_size = config.chunk * config.channels;
+        info.pool_depth = config.pool_depth;
+        info.thread_group = config.thread_group;
+        info.thread_priority = READER_PRIORITY_HIGH;
+        info.sample_format = config.sample_format;
+        info.replay_path = path;
+        info.replay_loop = 1;
+    }
+
+    auto poll = start_polling(&handles[0], config.tasks);
+    if (poll == NULL) {
+        fprintf(stderr, "NILoopBench: start_polling failed\n");
+        timeEndPeriod(1);
+        DeleteFileW(path);
+        return 2;
+    }
+
+    std::vector<task_result> results(config.tasks);
+    for (auto& r : results) {
+        memset(&r, 0, sizeof(r));
+        r.last_sequence = -1;
+        r.anchor = -1;
+    }
+
+    std::vector<double> latency_us;         // from the moment the last sample of a buffer was due
+    std::vector<double> handoff_us;         // from the moment the loop queued the buffer
+    double checksum = 0;
+
+    LARGE_INTEGER start, now;
+    QueryPerformanceCounter(&start);
+    auto warmup_end = start.QuadPart + (long long) (config.warmup_seconds * freq.QuadPart);
+    auto end = warmup_end + (long long) (config.seconds * freq.QuadPart);
+    long long measure_start = 0;
+
+    do {
+        auto processed = false;
+
+        for (int t = 0; t < config.tasks; t++) {
+            buffer_lease lease;
+            auto result = acquire_buffer(poll, handles[t].handle, &lease);
+            if (result != 0) continue;
+
+            processed = true;
+            QueryPerformanceCounter(&now);
+
+            auto& r = results[t];
+            auto due_ticks = (long long) ((lease.first_sample + lease.samples) * freq.QuadPart / config.rate);
+            if (r.anchor < 0) {
+                r.anchor = lease.timestamp - due_ticks;
+            }
+
+            if (now.QuadPart >= warmup_end) {
+                if (measure_start == 0) measure_start = now.QuadPart;
+
+                latency_us.push_back((now.QuadPart - (r.anchor + due_ticks)) * 1e6 / freq.QuadPart);
+                handoff_us.push_back((now.QuadPart - lease.timestamp) * 1e6 / freq.QuadPart);
+                r.buffers++;
+                r.samples += lease.samples;
+                if (r.last_sequence >= 0 && lease.sequence > r.last_sequence + 1) {
+                    r.gaps += lease.sequence - r.last_sequence - 1;
+                }
+            }
+            r.last_sequence = lease.sequence;
+
+            if (config.touch) checksum += touch_samples(lease, config.channels, config.sample_format);
+            if (config.work_us > 0) spin_us(config.work_us, freq.QuadPart);
+
+            release_buffer(poll, handles[t].handle, lease.id);
+        }
+
+        if (!processed) {
+            wait_any_buffer(poll, 10);
+        }
+
+        QueryPerformanceCounter(&now);
+    } while (now.QuadPart < end);
+
+    auto elapsed = (measure_start > 0) ? (double) (now.QuadPart - measure_start) / freq.QuadPart : 0.0;
+
+    for (int t = 0; t < config.tasks; t++) {
+        get_pool_stats(poll, handles[t].handle, &results[t].pool);
+        get_telemetry(poll, handles[t].handle, &results[t].telemetry);
+    }
+
+    stop_polling(poll);
+    timeEndPeriod(1);
+    DeleteFileW(path);
+
+    long long samples = 0, overruns = 0, gaps = 0, sleeps = 0;
+    for (auto& r : results) {
+        samples += r.samples;
+        overruns += r.pool.overruns;
+        gaps += r.gaps;
+        sleeps += r.telemetry.sleeps;
+    }
+
+    FILE* out = stdout;
+    if (!config.out_path.empty() && fopen_s(&out, config.out_path.c_str(), "w") != 0) {
+        fprintf(stderr, "NILoopBench: can't open %s\n", config.out_path.c_str());
+        return 2;
+    }
+
+    auto sample_size = (config.sample_format == SAMPLE_FORMAT_RAW_I16) ? 2 : 8;
+    auto per_second = (elapsed > 0) ? samples * config.channels / elapsed : 0.0;
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"config\": { \"tasks\": %d, \"channels\": %d, \"rate\": %.0f, \"chunk\": %d, \"seconds\": %.1f, \"format\": \"%s\", \"threads\": \"%s\", \"pool\": %d, \"work_us\": %d, \"touch\": %s },\n",
+        config.tasks, config.channels, config.rate, config.chunk, config.seconds,
+        (config.sample_format == SAMPLE_FORMAT_RAW_I16) ? "i16" : "f64",
+        (config.thread_group == THREAD_GROUP_OWN) ? "own" : "shared",
+        config.pool_depth, config.work_us,
+        config.touch ? "true" : "false");
+    fprintf(out, "  \"throughput\": { \"samples_per_s\": %.0f, \"expected_samples_per_s\": %.0f, \"mb_per_s\": %.2f },\n",
+        per_second,
+        config.tasks * config.channels * config.rate,
+        per_second * sample_size / (1024 * 1024));
+    write_latency(out, "latency_us", latency_us);
+    write_latency(out, "handoff_us", handoff_us);
+    fprintf(out, "  \"overruns\": %lld,\n", overruns);
+    fprintf(out, "  \"lost_buffers\": %lld,\n", gaps);
+    fprintf(out, "  \"starved_sleeps\": %lld,\n", sleeps);
+    fprintf(out, "  \"tasks\": [\n");
+    for (int t = 0; t < config.tasks; t++) {
+        auto& r = results[t];
+        fprintf(out, "    { \"buffers\": %lld, \"samples\": %lld, \"overruns\": %lld, \"lost_buffers\": %lld, \"in_use_high_water\": %d, \"depth\": %d, \"read_us_max\": %lld }%s\n",
+            r.buffers, r.samples, r.pool.overruns, r.gaps, r.pool.in_use_high_water, r.pool.depth,
+            r.telemetry.read_us_max,
+            (t + 1 < config.tasks) ? "," : "");
+    }
+    fprintf(out, "  ],\n");
+    fprintf(out, "  \"checksum\": %g\n", checksum);
+    fprintf(out, "}\n");
+
+    if (out != stdout) fclose(out);
+
+    return 0;
+}
@@ -76,5 +76,15 @@ namespace NodeSystemLib2.FormatData1D {
             return _readBuffer;
         }
 
+        // the queued samples in place, read only. They stay valid until released with Consume
+        public double[] GetReadSegments(out int offset, out int count1, out int count2) {
+            return _queue.GetReadSegments(out offset, out count1, out count2);
+        }
+
+        public int Consume(int elements) {
+            if (elements < 0) throw new ArgumentOutOfRangeException();
+            return _queue.Consume(elements);
+        }
+
     }
 }
@@ -59,6 +59,24 @@ namespace NodeSystemLib2.FormatData1D {
             return read;
         }
 
+        public T[] GetReadSegments(out int offset, out int count1, out int count2) {
+            return _buffer.GetReadSegments(out offset, out count1, out count2);
+        }
+
+        public int Consume(int elements) {
+            return _buffer.Consume(elements);
+        }
+
+        public T[] GetWriteSegments(out int offset, out int count1, out int count2) {
+            return _buffer.GetWriteSegments(out offset, out count1, out count2);
+        }
+
+        public int Commit(int elements) {
+            var written = _buffer.Commit(elements);
+            Time = Time.Increment(written, Samplerate);
+            return written;
+        }
+
         public int Write(IReadOnlyTimeLocatedBuffer1D<T> source, int offset, int elements) {
             var written = _buffer.Write(source.Data, offset, elements);
             Time = Time.Increment(written, Samplerate);
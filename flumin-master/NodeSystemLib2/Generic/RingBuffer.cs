@@ -228,6 +228,71 @@ namespace NodeSystemLib2 {
             }
         }
 
+        /// <summary>
+        /// Gives access to the data available for reading without copying it. The data is
+        /// <paramref name="count1"/> elements of the returned array starting at <paramref name="offset"/>,
+        /// followed by <paramref name="count2"/> elements starting at index 0 if it wraps around.
+        /// The elements stay valid until they are released with <see cref="Consume(int)"/>.
+        /// </summary>
+        /// <returns>the array backing the ring buffer</returns>
+        public T[] GetReadSegments(out int offset, out int count1, out int count2) {
+            lock (this) {
+                offset = ReadPosition;
+                count1 = Math.Min(Available, Capacity - ReadPosition);
+                count2 = Available - count1;
+                return _data;
+            }
+        }
+
+        /// <summary>
+        /// Releases elements read in place through <see cref="GetReadSegments(out int, out int, out int)"/>
+        /// </summary>
+        /// <param name="count">number of elements to release</param>
+        /// <returns>number of elements actually released</returns>
+        /// <exception cref="ArgumentOutOfRangeException">negative count</exception>
+        public int Consume(int count) {
+            if (count < 0) throw new ArgumentOutOfRangeException();
+            lock (this) {
+                var totalCount = Math.Min(count, Available);
+                if (totalCount == 0) return 0;
+                ReadPosition = (ReadPosition + totalCount) % Capacity;
+                Available -= totalCount;
+                return totalCount;
+            }
+        }
+
+        /// <summary>
+        /// Gives access to the free space of the buffer to write into it in place. Laid out like
+        /// <see cref="GetReadSegments(out int, out int, out int)"/>. Elements written there become
+        /// readable with <see cref="Commit(int)"/>.
+        /// </summary>
+        /// <returns>the array backing the ring buffer</returns>
+        public T[] GetWriteSegments(out int offset, out int count1, out int count2) {
+            lock (this) {
+                offset = WritePosition;
+                count1 = Math.Min(Free, Capacity - WritePosition);
+                count2 = Free - count1;
+                return _data;
+            }
+        }
+
+        /// <summary>
+        /// Publishes elements written in place through <see cref="GetWriteSegments(out int, out int, out int)"/>
+        /// </summary>
+        /// <param name="count">number of elements to publish</param>
+        /// <returns>number of elements actually published. Never more than the free space.</returns>
+        /// <exception cref="ArgumentOutOfRangeException">negative count</exception>
+        public int Commit(int count) {
+            if (count < 0) throw new ArgumentOutOfRangeException();
+            lock (this) {
+                var totalCount = Math.Min(count, Free);
+                if (totalCount == 0) return 0;
+                WritePosition = (WritePosition + totalCount) % Capacity;
+                Available += totalCount;
+                return totalCount;
+            }
+        }
+
         public void Dispose() {
             if (!_disposed) {
                 _dataPin.Free();
@@ -0,0 +1,19 @@
+// PythonWorker.cpp : hosts the python script of one node in its own process.
+//
+// Started by PythonWrap as
+//     PythonWorker.exe <name> <host pid> <python home>
+// where name identifies the shared memory and events set up by the host. The
+// work itself is done by RunWorker in PythonWrap, so the worker runs exactly
+// the same interpreter glue as the in-process nodes.
+
+#include "stdafx.h"
+
+extern "C" __declspec(dllimport) int RunWorker(const wchar_t* name, DWORD host_pid, const wchar_t* python_home);
+
+int wmain(int argc, wchar_t* argv[]) {
+    if (argc < 4) {
+        return 1;
+    }
+
+    return RunWorker(argv[1], wcstoul(argv[2], NULL, 10), argv[3]);
+}
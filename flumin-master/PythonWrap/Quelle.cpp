@@ -2,7 +2,11 @@
 #include <Python.h>
 #include <frameobject.h>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
 #include <numpy/arrayobject.h>
+#include <windows.h>
 
 struct module_state {
 	PyObject *error;
@@ -60,8 +64,33 @@ EXPORTABLE PyObject* create_module(char* module_name, PyMethodDef* methods, int
 	return module;
 }
 
-EXPORTABLE void init_numpy() {
-	_import_array();
+// All nodes share one interpreter. Once it is set up the initializing thread
+// gives up the GIL and every thread calling into python takes it with
+// AcquireGil, so nodes on different graph threads can overlap whenever one of
+// them is outside the interpreter
+static PyThreadState* main_thread_state = NULL;
+
+EXPORTABLE void ReleaseMainThread() {
+	PyEval_InitThreads();
+	main_thread_state = PyEval_SaveThread();
+}
+
+EXPORTABLE int AcquireGil() {
+	return (int)PyGILState_Ensure();
+}
+
+EXPORTABLE void ReleaseGil(int state) {
+	PyGILState_Release((PyGILState_STATE)state);
+}
+
+// lets other threads run python while the caller does work that doesn't touch
+// python objects
+EXPORTABLE PyThreadState* SaveThread() {
+	return PyEval_SaveThread();
+}
+
+EXPORTABLE void RestoreThread(PyThreadState* state) {
+	PyEval_RestoreThread(state);
 }
 
 EXPORTABLE void IncRef(PyObject* obj) {
@@ -72,6 +101,28 @@ EXPORTABLE void DecRef(PyObject* obj) {
 	Py_XDECREF(obj);
 }
 
+// Counted while prepared calls of a context run. Times are performance
+// counter ticks, except cpu_time which is in the 100ns units of GetThreadTimes
+struct ContextCounters {
+	long long calls;
+	long long wall_time;
+	long long cpu_time;
+	long long marshal_time;
+	long long array_bytes;
+	long long array_count;
+};
+
+// Samples the line of the script that runs every interval ticks. The samples
+// are taken from line events, a sample that falls into a call to numpy or
+// another module counts for the script line that made the call
+struct LineProfile {
+	long long interval;
+	long long next_sample;
+	long long remaining;    // until the next sample, carried over between calls
+	int last_line;
+	std::unordered_map<int, long long> samples;
+};
+
 struct PyContext {
 	PyObject* globals;
 	PyObject* locals;
@@ -80,14 +131,228 @@ struct PyContext {
 	int error_line;
 	int error_offset;
 	bool is_error;
+
+	ContextCounters counters;
+	LineProfile* profile;
 };
 
+// the context whose prepared call runs on this thread, marshalling and
+// allocations are accounted to it
+static thread_local PyContext* current_context = NULL;
+
+// numpy before 1.23 reports every allocation of array data, also those made
+// by the scripts themselves. Newer versions only count the arrays made here
+#if NPY_API_VERSION < 0x00000010
+#define HAVE_DATAMEM_HOOK
+
+static void CountAllocation(void* inp, void* outp, size_t size, void* user_data) {
+	// frees come with outp NULL
+	auto context = current_context;
+	if (context == NULL || outp == NULL) return;
+
+	context->counters.array_bytes += size;
+	context->counters.array_count++;
+}
+#endif
+
+EXPORTABLE void init_numpy() {
+	_import_array();
+
+#ifdef HAVE_DATAMEM_HOOK
+	void* old_data;
+	PyDataMem_SetEventHook(CountAllocation, NULL, &old_data);
+#endif
+}
+
+static long long PerformanceCounter() {
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+static double PerformanceSeconds(long long ticks) {
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return (double)ticks / frequency.QuadPart;
+}
+
+static long long ThreadCpuTime() {
+	FILETIME created, exited, kernel, user;
+	GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user);
+
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (long long)(k.QuadPart + u.QuadPart);
+}
+
 EXPORTABLE int HasError(PyContext* context) { return context->is_error; }
 
 EXPORTABLE const char* GetError(PyContext* context) { return context->error.c_str(); }
 EXPORTABLE int GetErrorLine(PyContext* context) { return context->error_line; }
 EXPORTABLE int GetErrorOffset(PyContext* context) { return context->error_offset; }
 
+struct ContextStats {
+	long long calls;
+	double wall_seconds;
+	double cpu_seconds;
+	double marshal_seconds;
+	long long array_bytes;
+	long long array_count;
+};
+
+// The counters are written by the thread running the context without a lock,
+// a read from another thread can be off by the call in progress
+EXPORTABLE void GetContextStats(PyContext* context, ContextStats* stats) {
+	auto& counters = context->counters;
+	stats->calls = counters.calls;
+	stats->wall_seconds = PerformanceSeconds(counters.wall_time);
+	stats->cpu_seconds = counters.cpu_time / 1e7;
+	stats->marshal_seconds = PerformanceSeconds(counters.marshal_time);
+	stats->array_bytes = counters.array_bytes;
+	stats->array_count = counters.array_count;
+}
+
+EXPORTABLE void ResetContextStats(PyContext* context) {
+	memset(&context->counters, 0, sizeof(context->counters));
+	if (context->profile != NULL) {
+		context->profile->samples.clear();
+	}
+}
+
+// interval_us of 0 turns line profiling off and drops the samples. Has to be
+// called while none of the context's calls run
+EXPORTABLE void SetLineProfiling(PyContext* context, int interval_us) {
+	if (interval_us <= 0) {
+		delete context->profile;
+		context->profile = NULL;
+		return;
+	}
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+
+	if (context->profile == NULL) {
+		context->profile = new LineProfile();
+	}
+	context->profile->interval = max(1LL, frequency.QuadPart * interval_us / 1000000);
+	context->profile->remaining = context->profile->interval;
+}
+
+// fills lines and samples with up to count lines, the most sampled first, and
+// returns how many were written
+EXPORTABLE int GetHotLines(PyContext* context, int* lines, long long* samples, int count) {
+	if (context->profile == NULL) return 0;
+
+	std::vector<std::pair<int, long long>> sorted(context->profile->samples.begin(), context->profile->samples.end());
+	std::sort(sorted.begin(), sorted.end(), [](const std::pair<int, long long>& a, const std::pair<int, long long>& b) {
+		return a.second > b.second;
+	});
+
+	count = min(count, (int)sorted.size());
+	for (int i = 0; i < count; i++) {
+		lines[i] = sorted[i].first;
+		samples[i] = sorted[i].second;
+	}
+	return count;
+}
+
+// managed code brackets its own conversions of array data with these two
+EXPORTABLE long long MarshalBegin() {
+	return PerformanceCounter();
+}
+
+EXPORTABLE void MarshalEnd(long long start) {
+	if (current_context != NULL) {
+		current_context->counters.marshal_time += PerformanceCounter() - start;
+	}
+}
+
+// moves the pending python exception into the context
+static void FetchError(PyContext* context) {
+	context->is_error = true;
+
+	PyObject *ptype, *pvalue, *ptraceback;
+	PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+	PyErr_NormalizeException(&ptype, &pvalue, &ptraceback);
+
+	PyObject *lineObj = PyObject_GetAttrString(pvalue, "lineno");
+	if (lineObj) {
+		context->error_line = PyLong_AsLong(lineObj);
+		Py_DECREF(lineObj);
+	} else {
+		context->error_line = -1;
+	}
+
+	PyObject *offsetObj = PyObject_GetAttrString(pvalue, "offset");
+	if (offsetObj) {
+		context->error_offset = PyLong_AsLong(offsetObj);
+		Py_DECREF(offsetObj);
+	} else {
+		context->error_offset = -1;
+	}
+
+	PyObject *textObj = PyObject_Repr(pvalue);
+	if (textObj) {
+		PyObject * temp_bytes = PyUnicode_AsEncodedString(textObj, "utf-8", "strict");
+		if (temp_bytes != NULL) {
+			auto my_result = PyBytes_AS_STRING(temp_bytes); // Borrowed pointer
+			context->error = std::string(my_result);
+			Py_DECREF(temp_bytes);
+		} else {
+			context->error = "unknown error";
+		}
+		Py_DECREF(textObj);
+	} else {
+		context->error = "unknown error";
+	}
+
+	Py_XDECREF(ptype);
+	Py_XDECREF(pvalue);
+	Py_XDECREF(ptraceback);
+
+	// the attribute lookups above fail for exceptions without line info
+	PyErr_Clear();
+}
+
+static PyObject* FrameGlobals(PyFrameObject* frame) {
+#if PY_VERSION_HEX >= 0x030B0000
+	// the frame keeps its own reference
+	auto globals = PyFrame_GetGlobals(frame);
+	Py_DECREF(globals);
+	return globals;
+#else
+	return frame->f_globals;
+#endif
+}
+
+// counts the samples that fell due up to now for the line that ran last
+static void TakeSamples(LineProfile* profile, long long now) {
+	if (now < profile->next_sample) return;
+
+	auto due = (now - profile->next_sample) / profile->interval + 1;
+	if (profile->last_line > 0) {
+		profile->samples[profile->last_line] += due;
+	}
+	profile->next_sample += due * profile->interval;
+}
+
+static int TraceLines(PyObject* obj, PyFrameObject* frame, int what, PyObject* arg) {
+	if (what != PyTrace_LINE) return 0;
+
+	auto context = current_context;
+	if (context == NULL || context->profile == NULL) return 0;
+
+	// lines of other modules don't move the sampled line away from the script
+	if (FrameGlobals(frame) != context->globals) return 0;
+
+	TakeSamples(context->profile, PerformanceCounter());
+	context->profile->last_line = PyFrame_GetLineNumber(frame);
+	return 0;
+}
+
 
 EXPORTABLE int PyLong_MyCheck(PyObject* obj) {
 	return PyLong_Check(obj);
@@ -157,24 +422,219 @@ EXPORTABLE int PyArray_GetSize(PyObject* obj) {
 	return PyArray_SIZE(obj);
 }
 
+// adds the time since start and, if numpy doesn't report it, the data of a
+// new array to the counters of the running context
+static void CountArray(PyObject* array, long long start) {
+	auto context = current_context;
+	if (context == NULL) return;
+
+	context->counters.marshal_time += PerformanceCounter() - start;
+#ifndef HAVE_DATAMEM_HOOK
+	if (array != NULL) {
+		context->counters.array_bytes += PyArray_NBYTES((PyArrayObject*)array);
+		context->counters.array_count++;
+	}
+#endif
+}
+
 EXPORTABLE PyObject* PyArray_CreateEmpty(int size, int type) {
-	npy_int dim[1] = { size };
+	auto start = PerformanceCounter();
+	npy_intp dim[1] = { size };
 	auto array = PyArray_SimpleNew(1, dim, type);
 	auto data = (int*)PyArray_DATA(array);
-	
+	NPY_BEGIN_THREADS_DEF;
+
+	NPY_BEGIN_THREADS_THRESHOLDED(size);
 	memset(data, '\0', PyArray_NBYTES(array));
+	NPY_END_THREADS;
 
+	CountArray(array, start);
 	return array;
 }
 
 EXPORTABLE PyObject* PyArray_Create(void* values, int size, int type) {
-	npy_int dim[1] = { size };
+	auto start = PerformanceCounter();
+	npy_intp dim[1] = { size };
 	auto array = PyArray_SimpleNew(1, dim, type);
 	auto data = (int*)PyArray_DATA(array);
 	auto elemSize = PyArray_ITEMSIZE(array);
+	NPY_BEGIN_THREADS_DEF;
 
+	NPY_BEGIN_THREADS_THRESHOLDED(size);
 	memcpy(data, values, size * elemSize);
+	NPY_END_THREADS;
 
+	CountArray(array, start);
+	return array;
+}
+
+// called once the last array viewing a wrapped buffer is gone
+typedef void (*BufferRelease)(void* cookie);
+
+struct BufferOwner {
+	BufferRelease release;
+	void* cookie;
+};
+
+static const char* BUFFER_OWNER = "PythonWrap.BufferOwner";
+
+static void ReleaseBufferOwner(PyObject* capsule) {
+	auto owner = (BufferOwner*)PyCapsule_GetPointer(capsule, BUFFER_OWNER);
+	if (owner->release != NULL) {
+		owner->release(owner->cookie);
+	}
+	delete owner;
+}
+
+// creates an array on top of memory owned by the caller without copying it.
+// The array keeps a capsule as its base object, so release runs when numpy
+// drops the last view, also when creating the array fails
+static PyObject* WrapBuffer(void* data, npy_intp size, int type, int flags, BufferRelease release, void* cookie) {
+	auto start = PerformanceCounter();
+	npy_intp dim[1] = { size };
+	auto array = PyArray_New(&PyArray_Type, 1, dim, type, NULL, data, 0, flags, NULL);
+	if (array == NULL) {
+		if (release != NULL) release(cookie);
+		return NULL;
+	}
+
+	auto owner = new BufferOwner();
+	owner->release = release;
+	owner->cookie = cookie;
+
+	auto capsule = PyCapsule_New(owner, BUFFER_OWNER, ReleaseBufferOwner);
+	if (capsule == NULL) {
+		delete owner;
+		Py_DECREF(array);
+		if (release != NULL) release(cookie);
+		return NULL;
+	}
+
+	// steals the capsule reference even if it fails
+	if (PyArray_SetBaseObject((PyArrayObject*)array, capsule) < 0) {
+		Py_DECREF(array);
+		return NULL;
+	}
+
+	// a view allocates no data, only the time counts
+	if (current_context != NULL) {
+		current_context->counters.marshal_time += PerformanceCounter() - start;
+	}
+	return array;
+}
+
+EXPORTABLE PyObject* PyArray_Wrap(void* data, npy_intp size, int type, BufferRelease release, void* cookie) {
+	return WrapBuffer(data, size, type, NPY_ARRAY_CARRAY, release, cookie);
+}
+
+EXPORTABLE PyObject* PyArray_WrapReadOnly(void* data, npy_intp size, int type, BufferRelease release, void* cookie) {
+	return WrapBuffer(data, size, type, NPY_ARRAY_CARRAY_RO, release, cookie);
+}
+
+// Arrays of one port kept for reuse. The pool owns base arrays with room for
+// capacity elements and hands out a fresh view of the first count elements of
+// one, so the shape numpy allocated the data with is never changed. A view
+// references its base, so a base is only reused once nobody but the pool
+// references it, also through views a script made of the view. The pool keeps
+// at most MAX_POOL_ARRAYS bases, while a script holds on to all of them it
+// gets views of bases the pool doesn't track, those are freed as soon as the
+// script drops them
+static const int MAX_POOL_ARRAYS = 4;
+
+struct ArrayPool {
+	int capacity;
+	int type;
+	std::vector<PyObject*> arrays;
+};
+
+EXPORTABLE ArrayPool* CreateArrayPool(int capacity, int type) {
+	auto pool = new ArrayPool();
+	pool->capacity = capacity;
+	pool->type = type;
+	return pool;
+}
+
+static void ClearArrayPool(ArrayPool* pool) {
+	for (auto array : pool->arrays) {
+		Py_DECREF(array);
+	}
+	pool->arrays.clear();
+}
+
+// returns a new reference to an array holding a copy of the count elements
+// at values, or NULL if no array could be allocated
+EXPORTABLE PyObject* ArrayPoolTake(ArrayPool* pool, void* values, int count) {
+	auto start = PerformanceCounter();
+
+	// the bases are too small now, those still in use live on without the pool
+	if (count > pool->capacity) {
+		ClearArrayPool(pool);
+		pool->capacity = count;
+	}
+
+	PyObject* base = NULL;
+	bool pooled = true;
+	for (auto candidate : pool->arrays) {
+		if (Py_REFCNT(candidate) == 1) {
+			base = candidate;
+			break;
+		}
+	}
+
+	if (base == NULL) {
+		npy_intp dim[1] = { pool->capacity };
+		base = PyArray_SimpleNew(1, dim, pool->type);
+		if (base == NULL) return NULL;
+
+		CountArray(base, start);
+		start = PerformanceCounter();
+
+		if ((int)pool->arrays.size() < MAX_POOL_ARRAYS) {
+			pool->arrays.push_back(base);
+		} else {
+			pooled = false;
+		}
+	}
+
+	auto baseObject = (PyArrayObject*)base;
+	memcpy(PyArray_DATA(baseObject), values, count * PyArray_ITEMSIZE(baseObject));
+
+	npy_intp dim[1] = { count };
+	auto view = PyArray_New(&PyArray_Type, 1, dim, pool->type, NULL, PyArray_DATA(baseObject), 0, NPY_ARRAY_CARRAY, NULL);
+	if (view == NULL) {
+		if (!pooled) Py_DECREF(base);
+		return NULL;
+	}
+
+	// the pool keeps its own reference, a base it doesn't track belongs to the
+	// view alone. Steals the reference even if it fails
+	if (pooled) {
+		Py_INCREF(base);
+	}
+	if (PyArray_SetBaseObject((PyArrayObject*)view, base) < 0) {
+		Py_DECREF(view);
+		return NULL;
+	}
+
+	if (current_context != NULL) {
+		current_context->counters.marshal_time += PerformanceCounter() - start;
+	}
+	return view;
+}
+
+EXPORTABLE void ReleaseArrayPool(ArrayPool* pool) {
+	ClearArrayPool(pool);
+	delete pool;
+}
+
+// returns obj itself if it already is a contiguous 1D array of type, else a
+// converted copy. New reference, NULL with the python error cleared if obj
+// can't be converted
+EXPORTABLE PyObject* PyArray_AsContiguous(PyObject* obj, int type) {
+	auto array = PyArray_FROMANY(obj, type, 1, 1, NPY_ARRAY_CARRAY_RO);
+	if (array == NULL) {
+		PyErr_Clear();
+	}
 	return array;
 }
 
@@ -193,46 +653,7 @@ EXPORTABLE PyObject* CallFunc(PyContext* context, PyObject* func, PyObject** arg
 
 	auto result = PyEval_EvalCodeEx(func, context->globals, context->locals, args, argc, NULL, 0, NULL, 0, NULL, NULL);
 	if (PyErr_Occurred()) {
-		context->is_error = true;
-
-		PyObject *ptype, *pvalue, *ptraceback;
-		PyErr_Fetch(&ptype, &pvalue, &ptraceback);
-		PyErr_NormalizeException(&ptype, &pvalue, &ptraceback);
-
-		PyObject *lineObj = PyObject_GetAttrString(pvalue, "lineno");
-		if (lineObj) {
-			context->error_line = PyLong_AsLong(lineObj);
-			Py_DECREF(lineObj);
-		}
-		else {
-			context->error_line = -1;
-		}
-
-		PyObject *offsetObj = PyObject_GetAttrString(pvalue, "offset");
-		if (offsetObj) {
-			context->error_offset = PyLong_AsLong(offsetObj);
-			Py_DECREF(offsetObj);
-		}
-		else {
-			context->error_offset = -1;
-		}
-
-		PyObject *textObj = PyObject_Repr(pvalue);
-		if (textObj) {
-			PyObject * temp_bytes = PyUnicode_AsEncodedString(textObj, "utf-8", "strict");
-			if (temp_bytes != NULL) {
-				auto my_result = PyBytes_AS_STRING(temp_bytes); // Borrowed pointer
-				context->error = std::string(my_result);
-				Py_DECREF(temp_bytes);
-			}
-			else {
-				context->error = "unknown error";
-			}
-			Py_DECREF(textObj);
-		}
-		else {
-			context->error = "unknown error";
-		}
+		FetchError(context);
 	}
 
 	return result;
@@ -257,54 +678,162 @@ EXPORTABLE PyContext* CompileCode(char* code, PyObject** modules, int moduleCoun
 
 	auto locals = PyDict_New();
 
+	// kept also when the script fails so ReleaseContext frees them
+	context->locals = locals;
+	context->globals = globals;
+
 	PyErr_Clear();
-	PyRun_String(code, Py_file_input, globals, globals);
+	auto result = PyRun_String(code, Py_file_input, globals, globals);
+	Py_XDECREF(result);
 
 	if (PyErr_Occurred()) {
-		context->is_error = true;
-
-		PyObject *ptype, *pvalue, *ptraceback;
-		PyErr_Fetch(&ptype, &pvalue, &ptraceback);
-		PyErr_NormalizeException(&ptype, &pvalue, &ptraceback);
-		
-		PyObject *lineObj = PyObject_GetAttrString(pvalue, "lineno");
-		if (lineObj) {
-			context->error_line = PyLong_AsLong(lineObj);
-			Py_DECREF(lineObj);
-		} else {
-			context->error_line = -1;
-		}
+		FetchError(context);
+		return context;
+	}
 
-		PyObject *offsetObj = PyObject_GetAttrString(pvalue, "offset");
-		if (offsetObj) {
-			context->error_offset = PyLong_AsLong(offsetObj);
-			Py_DECREF(offsetObj);
-		}
-		else {
-			context->error_offset = -1;
-		}
+	context->is_error = false;
 
-		PyObject *textObj = PyObject_Repr(pvalue);
-		if (textObj) {
-			PyObject * temp_bytes = PyUnicode_AsEncodedString(textObj, "utf-8", "strict");
-			if (temp_bytes != NULL) {
-				auto my_result = PyBytes_AS_STRING(temp_bytes); // Borrowed pointer
-				context->error = std::string(my_result);
-				Py_DECREF(temp_bytes);
-			} else {
-				context->error = "unknown error";
-			}
-			Py_DECREF(textObj);
-		} else {
-			context->error = "unknown error";
-		}
+	return context;
+}
 
-		return context;
+// frees a context made by CompileCode together with the globals of its
+// script. Prepared calls of the context have to be released before
+EXPORTABLE void ReleaseContext(PyContext* context) {
+	if (context == NULL) return;
+
+	if (current_context == context) {
+		current_context = NULL;
 	}
 
-	context->locals = locals;
-	context->globals = globals;
+	Py_XDECREF(context->locals);
+	Py_XDECREF(context->globals);
+	delete context->profile;
+	delete context;
+}
+
+// A function of a context looked up once and called many times. The argument
+// tuple is kept between calls and only replaced when the callee held on to it
+struct PreparedCall {
+	PyContext* context;
+	PyObject* callable;
+	PyObject* args;
+	int argc;
+};
+
+EXPORTABLE PreparedCall* PrepareCall(PyContext* context, const char* name, int argc) {
 	context->is_error = false;
 
-	return context;
+	auto callable = PyDict_GetItemString(context->locals, name);
+	if (callable == NULL) {
+		callable = PyDict_GetItemString(context->globals, name);
+	}
+	if (callable == NULL || !PyCallable_Check(callable)) {
+		return NULL;
+	}
+
+	auto args = PyTuple_New(argc);
+	if (args == NULL) {
+		FetchError(context);
+		return NULL;
+	}
+
+	// arguments that are never set are passed as None
+	for (int i = 0; i < argc; i++) {
+		Py_INCREF(Py_None);
+		PyTuple_SET_ITEM(args, i, Py_None);
+	}
+
+	auto call = new PreparedCall();
+	call->context = context;
+	call->callable = callable;
+	call->args = args;
+	call->argc = argc;
+	Py_INCREF(callable);
+
+	return call;
+}
+
+static int EnsureOwnArgs(PreparedCall* call) {
+	if (Py_REFCNT(call->args) == 1) return 1;
+
+	auto args = PyTuple_New(call->argc);
+	if (args == NULL) return 0;
+
+	for (int i = 0; i < call->argc; i++) {
+		auto item = PyTuple_GET_ITEM(call->args, i);
+		Py_INCREF(item);
+		PyTuple_SET_ITEM(args, i, item);
+	}
+
+	Py_DECREF(call->args);
+	call->args = args;
+	return 1;
+}
+
+// arg is borrowed, the call keeps its own reference until it is replaced.
+// NULL resets the argument to None
+EXPORTABLE int SetCallArg(PreparedCall* call, int index, PyObject* arg) {
+	if (index < 0 || index >= call->argc) return 0;
+	if (!EnsureOwnArgs(call)) return 0;
+
+	if (arg == NULL) arg = Py_None;
+
+	auto old = PyTuple_GET_ITEM(call->args, index);
+	Py_INCREF(arg);
+	PyTuple_SET_ITEM(call->args, index, arg);
+	Py_DECREF(old);
+
+	return 1;
+}
+
+// returns a new reference or NULL, in which case the context has the error
+EXPORTABLE PyObject* InvokeCall(PreparedCall* call) {
+	auto context = call->context;
+	context->is_error = false;
+
+	auto outer = current_context;
+	current_context = context;
+
+	auto cpu_start = ThreadCpuTime();
+	auto wall_start = PerformanceCounter();
+
+	auto profile = context->profile;
+	if (profile != NULL) {
+		profile->next_sample = wall_start + profile->remaining;
+		profile->last_line = 0;
+		PyEval_SetTrace(TraceLines, NULL);
+	}
+
+	// the saving is the lookup and the argument tuple, the call itself is a
+	// plain PyObject_Call on the Python 3.5 FluPy ships
+	auto result = PyObject_Call(call->callable, call->args, NULL);
+
+	auto wall_end = PerformanceCounter();
+
+	if (profile != NULL) {
+		TakeSamples(profile, wall_end);
+		profile->remaining = profile->next_sample - wall_end;
+
+		// a nested call of another context doesn't end the outer one's profiling
+		if (outer == NULL || outer->profile == NULL) {
+			PyEval_SetTrace(NULL, NULL);
+		}
+	}
+
+	context->counters.calls++;
+	context->counters.wall_time += wall_end - wall_start;
+	context->counters.cpu_time += ThreadCpuTime() - cpu_start;
+	current_context = outer;
+
+	if (result == NULL) {
+		FetchError(context);
+	}
+
+	return result;
+}
+
+EXPORTABLE void ReleaseCall(PreparedCall* call) {
+	Py_DECREF(call->args);
+	Py_DECREF(call->callable);
+	delete call;
 }
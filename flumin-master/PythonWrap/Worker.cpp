@@ -0,0 +1,634 @@
+#undef _DEBUG
+#include <Python.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <numpy/ndarraytypes.h>
+#include "Worker.h"
+
+#define EXPORTABLE extern "C" __declspec(dllexport)
+
+// exported by Quelle.cpp
+struct PyContext;
+struct PreparedCall;
+
+extern "C" {
+	PyObject* create_module(char* module_name, PyMethodDef* methods, int methodCount, PyModuleDef** defOut);
+	void init_numpy();
+	PyContext* CompileCode(char* code, PyObject** modules, int moduleCount);
+	void ReleaseContext(PyContext* context);
+	int HasError(PyContext* context);
+	const char* GetError(PyContext* context);
+	int GetErrorLine(PyContext* context);
+	int GetErrorOffset(PyContext* context);
+	PreparedCall* PrepareCall(PyContext* context, const char* name, int argc);
+	PyObject* InvokeCall(PreparedCall* call);
+	void ReleaseCall(PreparedCall* call);
+	PyObject* PyArray_CreateEmpty(int size, int type);
+	void* PyArray_GetPointer(PyObject* obj);
+	int PyArray_GetSize(PyObject* obj);
+}
+
+static const int SPIN_COUNT         = 4000;
+static const DWORD STARTUP_TIMEOUT  = 30000;
+static const DWORD EXIT_TIMEOUT     = 1000;
+static const int MAX_IDLE_WORKERS   = 4;
+
+static void set_error(worker_header* header, const char* message, int line, int offset) {
+	strncpy_s(header->error, WORKER_ERROR_LENGTH, message, _TRUNCATE);
+	header->error_line = line;
+	header->error_offset = offset;
+}
+
+// waits until the other side has set seq to expected. Spins a little first,
+// most answers to process calls arrive faster than a wait on the event would
+// return. other is the process handle of the other side
+static int wait_for(volatile LONG* seq, LONG expected, HANDLE event, HANDLE other, DWORD timeout) {
+	for (int i = 0; i < SPIN_COUNT; i++) {
+		if (*seq == expected) return WORKER_OK;
+		YieldProcessor();
+	}
+
+	auto deadline = GetTickCount64() + timeout;
+	HANDLE handles[] = { event, other };
+
+	while (*seq != expected) {
+		DWORD remaining = INFINITE;
+		if (timeout != INFINITE) {
+			auto now = GetTickCount64();
+			if (now >= deadline) return WORKER_TIMEOUT;
+			remaining = (DWORD) (deadline - now);
+		}
+
+		auto result = WaitForMultipleObjects(2, handles, FALSE, remaining);
+		if (result == WAIT_OBJECT_0 + 1) {
+			// the event may have been set just before the other side exited
+			return *seq == expected ? WORKER_OK : WORKER_DIED;
+		}
+		if (result == WAIT_TIMEOUT) return WORKER_TIMEOUT;
+		if (result != WAIT_OBJECT_0) return WORKER_DIED;
+	}
+
+	return WORKER_OK;
+}
+
+// ---------------------------------------------------------------------------
+// worker process side
+
+struct worker_state {
+	worker_header* header;
+	PyObject* module;
+	PyObject* numpy;
+	PyContext* context;
+	PreparedCall* process;
+};
+
+static worker_state worker;
+
+static worker_port* find_port(worker_port* ports, int count, const char* name) {
+	for (int i = 0; i < count; i++) {
+		if (strcmp(ports[i].name, name) == 0) return &ports[i];
+	}
+	PyErr_Format(PyExc_KeyError, "no port named '%s'", name);
+	return NULL;
+}
+
+static PyObject* worker_get_samplerate(PyObject* self, PyObject* args) {
+	const char* name;
+	if (!PyArg_ParseTuple(args, "s", &name)) return NULL;
+
+	auto port = find_port(worker.header->inputs, worker.header->input_count, name);
+	if (port == NULL) return NULL;
+
+	return PyFloat_FromDouble(port->samplerate);
+}
+
+static PyObject* worker_set_samplerate(PyObject* self, PyObject* args) {
+	const char* name;
+	double samplerate;
+	if (!PyArg_ParseTuple(args, "sd", &name, &samplerate)) return NULL;
+
+	auto port = find_port(worker.header->outputs, worker.header->output_count, name);
+	if (port == NULL) return NULL;
+
+	port->samplerate = (int) samplerate;
+	return PyLong_FromLong(1);
+}
+
+static PyObject* worker_read_data_port(PyObject* self, PyObject* args) {
+	const char* name;
+	if (!PyArg_ParseTuple(args, "s", &name)) return NULL;
+
+	auto port = find_port(worker.header->inputs, worker.header->input_count, name);
+	if (port == NULL) return NULL;
+
+	// no more than the in-process node reads from its port buffer at once
+	auto available = min(ring_available(&port->ring), port->read_limit);
+	auto array = PyArray_CreateEmpty(available, NPY_DOUBLE);
+	if (array == NULL) return NULL;
+
+	ring_read(worker.header, &port->ring, (double*) PyArray_GetPointer(array), available);
+	return array;
+}
+
+static PyObject* worker_write_data_port(PyObject* self, PyObject* args) {
+	PyObject* data;
+	const char* name;
+	if (!PyArg_ParseTuple(args, "Os", &data, &name)) return NULL;
+
+	auto port = find_port(worker.header->outputs, worker.header->output_count, name);
+	if (port == NULL) return NULL;
+
+	auto array = PyObject_CallMethod(worker.numpy, "ascontiguousarray", "Os", data, "float64");
+	if (array == NULL) return NULL;
+
+	// like the in-process node, samples that don't fit are dropped
+	ring_write(worker.header, &port->ring, (double*) PyArray_GetPointer(array), PyArray_GetSize(array));
+	Py_DECREF(array);
+
+	return PyLong_FromLong(1);
+}
+
+static PyMethodDef worker_methods[] = {
+	{ "GetSamplerate", worker_get_samplerate, METH_VARARGS, NULL },
+	{ "SetSamplerate", worker_set_samplerate, METH_VARARGS, NULL },
+	{ "ReadDataPort", worker_read_data_port, METH_VARARGS, NULL },
+	{ "WriteDataPort", worker_write_data_port, METH_VARARGS, NULL },
+};
+
+static int fetch_context_error(const char* fallback) {
+	if (worker.context != NULL && HasError(worker.context)) {
+		set_error(worker.header, GetError(worker.context), GetErrorLine(worker.context), GetErrorOffset(worker.context));
+	} else {
+		set_error(worker.header, fallback, -1, -1);
+	}
+	return WORKER_PYTHON_ERROR;
+}
+
+// calls a function of the script once, the result is returned as a new reference
+static PyObject* call_once(const char* name, int* status) {
+	auto call = PrepareCall(worker.context, name, 0);
+	if (call == NULL) {
+		*status = fetch_context_error((std::string("Function not found: ") + name).c_str());
+		return NULL;
+	}
+
+	auto result = InvokeCall(call);
+	ReleaseCall(call);
+
+	*status = result == NULL ? fetch_context_error("unknown error") : WORKER_OK;
+	return result;
+}
+
+static int read_port_defs(PyObject* defs, const char* key, worker_port* ports, int* count) {
+	auto list = PyDict_Check(defs) ? PyDict_GetItemString(defs, key) : NULL;
+	if (list == NULL || !PyList_Check(list)) {
+		set_error(worker.header, (std::string("init has to return a dict with a list '") + key + "'").c_str(), -1, -1);
+		return WORKER_PYTHON_ERROR;
+	}
+
+	*count = 0;
+	for (Py_ssize_t i = 0; i < PyList_GET_SIZE(list) && *count < WORKER_MAX_PORTS; i++) {
+		const char* name;
+		const char* kind;
+		if (!PyArg_ParseTuple(PyList_GET_ITEM(list, i), "ss", &name, &kind)) {
+			PyErr_Clear();
+			set_error(worker.header, "port definitions have to be (name, type) tuples", -1, -1);
+			return WORKER_PYTHON_ERROR;
+		}
+
+		auto port = &ports[(*count)++];
+		memset(port, 0, sizeof(worker_port));
+		strncpy_s(port->name, WORKER_NAME_LENGTH, name, _TRUNCATE);
+
+		if (strcmp(kind, "data") == 0) {
+			port->kind = WORKER_PORT_DATA;
+		} else if (strcmp(kind, "value") == 0) {
+			port->kind = WORKER_PORT_VALUE;
+		} else {
+			set_error(worker.header, (std::string("unknown port format '") + kind + "' for port named " + name).c_str(), -1, -1);
+			return WORKER_PYTHON_ERROR;
+		}
+	}
+
+	return WORKER_OK;
+}
+
+static int handle_load() {
+	if (worker.process != NULL) {
+		ReleaseCall(worker.process);
+		worker.process = NULL;
+	}
+
+	auto header = worker.header;
+	auto code = (char*) header + WORKER_CODE_OFFSET;
+	code[min(header->code_size, WORKER_CODE_SIZE - 1)] = '\0';
+
+	header->input_count = 0;
+	header->output_count = 0;
+
+	if (worker.context != NULL) {
+		ReleaseContext(worker.context);
+		worker.context = NULL;
+	}
+
+	// a script that doesn't compile leaves the worker without a context
+	auto context = CompileCode(code, &worker.module, 1);
+	if (HasError(context)) {
+		set_error(header, GetError(context), GetErrorLine(context), GetErrorOffset(context));
+		ReleaseContext(context);
+		return WORKER_PYTHON_ERROR;
+	}
+
+	worker.context = context;
+	return WORKER_OK;
+}
+
+static int handle_init() {
+	if (worker.context == NULL) return WORKER_INVALID;
+
+	int status;
+	auto defs = call_once("init", &status);
+	if (defs == NULL) return status;
+
+	status = read_port_defs(defs, "in", worker.header->inputs, &worker.header->input_count);
+	if (status == WORKER_OK) {
+		status = read_port_defs(defs, "out", worker.header->outputs, &worker.header->output_count);
+	}
+
+	Py_DECREF(defs);
+	return status;
+}
+
+static int handle_prepare() {
+	if (worker.context == NULL) return WORKER_INVALID;
+
+	int status;
+	auto result = call_once("prepare", &status);
+	if (result == NULL) return status;
+	Py_DECREF(result);
+
+	if (worker.process != NULL) {
+		ReleaseCall(worker.process);
+	}
+
+	worker.process = PrepareCall(worker.context, "process", 0);
+	if (worker.process == NULL) return fetch_context_error("Function not found: process");
+	return WORKER_OK;
+}
+
+static int handle_process() {
+	if (worker.process == NULL) return WORKER_INVALID;
+
+	auto result = InvokeCall(worker.process);
+	if (result == NULL) return fetch_context_error("unknown error");
+
+	Py_DECREF(result);
+	return WORKER_OK;
+}
+
+// entry point of PythonWorker.exe. Serves the commands of the host until it
+// sends WORKER_EXIT or goes away
+EXPORTABLE int RunWorker(const wchar_t* name, DWORD host_pid, const wchar_t* python_home) {
+	wchar_t object_name[MAX_PATH];
+
+	worker_object_name(object_name, MAX_PATH, name, L"shm");
+	auto mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, object_name);
+	if (mapping == NULL) return 1;
+
+	worker_object_name(object_name, MAX_PATH, name, L"request");
+	auto request = OpenEventW(EVENT_ALL_ACCESS, FALSE, object_name);
+	worker_object_name(object_name, MAX_PATH, name, L"reply");
+	auto reply = OpenEventW(EVENT_ALL_ACCESS, FALSE, object_name);
+	auto host = OpenProcess(SYNCHRONIZE, FALSE, host_pid);
+	if (request == NULL || reply == NULL || host == NULL) return 1;
+
+	worker.header = (worker_header*) MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, WORKER_MAPPING_SIZE);
+	if (worker.header == NULL) return 1;
+
+	// python keeps the pointer
+	static std::wstring home = python_home;
+	Py_SetPythonHome(&home[0]);
+	Py_InitializeEx(0);
+
+	worker.numpy = PyImport_ImportModule("numpy");
+	init_numpy();
+	static char module_name[] = "Flumin";
+	worker.module = create_module(module_name, worker_methods, sizeof(worker_methods) / sizeof(worker_methods[0]), NULL);
+
+	auto header = worker.header;
+	LONG handled = 0;
+
+	while (true) {
+		if (wait_for(&header->request_seq, handled + 1, request, host, INFINITE) != WORKER_OK) break;
+		handled = header->request_seq;
+
+		int status = WORKER_OK;
+		switch (header->command) {
+		case WORKER_READY:   status = worker.numpy != NULL ? WORKER_OK : fetch_context_error("numpy could not be imported"); break;
+		case WORKER_LOAD:    status = handle_load(); break;
+		case WORKER_INIT:    status = handle_init(); break;
+		case WORKER_PREPARE: status = handle_prepare(); break;
+		case WORKER_PROCESS: status = handle_process(); break;
+		case WORKER_EXIT:    break;
+		default:             status = WORKER_INVALID; break;
+		}
+
+		header->status = status;
+		InterlockedExchange(&header->reply_seq, handled);
+		SetEvent(reply);
+
+		if (header->command == WORKER_EXIT) break;
+	}
+
+	Py_Finalize();
+	return 0;
+}
+
+// ---------------------------------------------------------------------------
+// host side
+
+struct python_worker {
+	HANDLE mapping;
+	HANDLE request;
+	HANDLE reply;
+	HANDLE process;
+	worker_header* header;
+	std::wstring python_home;
+	bool dead;
+};
+
+static std::mutex pool_lock;
+static std::vector<python_worker*> idle_workers;   // started, but never given a script
+static int spawning_workers = 0;                    // guarded by pool_lock as well
+static volatile LONG worker_counter = 0;
+
+static void destroy_worker(python_worker* w) {
+	if (w->process != NULL) {
+		if (!w->dead) {
+			w->header->command = WORKER_EXIT;
+			InterlockedIncrement(&w->header->request_seq);
+			SetEvent(w->request);
+			if (WaitForSingleObject(w->process, EXIT_TIMEOUT) != WAIT_OBJECT_0) {
+				TerminateProcess(w->process, 1);
+			}
+		}
+		CloseHandle(w->process);
+	}
+
+	if (w->header != NULL) UnmapViewOfFile(w->header);
+	if (w->mapping != NULL) CloseHandle(w->mapping);
+	if (w->request != NULL) CloseHandle(w->request);
+	if (w->reply != NULL) CloseHandle(w->reply);
+	delete w;
+}
+
+// sends a command and waits for the answer. A worker that crashes or doesn't
+// answer in time is killed and never reused
+static int worker_call(python_worker* w, int command, DWORD timeout) {
+	if (w->dead) return WORKER_DIED;
+
+	auto seq = w->header->request_seq + 1;
+	w->header->command = command;
+	InterlockedExchange(&w->header->request_seq, seq);
+	SetEvent(w->request);
+
+	auto result = wait_for(&w->header->reply_seq, seq, w->reply, w->process, timeout);
+	if (result != WORKER_OK) {
+		TerminateProcess(w->process, 1);
+		w->dead = true;
+		set_error(w->header, result == WORKER_TIMEOUT ? "python worker did not answer in time" : "python worker exited", -1, -1);
+		return result;
+	}
+
+	return w->header->status;
+}
+
+static std::wstring worker_executable() {
+	HMODULE module = NULL;
+	GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCWSTR) &worker_call, &module);
+
+	wchar_t path[MAX_PATH];
+	GetModuleFileNameW(module, path, MAX_PATH);
+
+	std::wstring exe = path;
+	return exe.substr(0, exe.find_last_of(L"\\/") + 1) + L"PythonWorker.exe";
+}
+
+static python_worker* spawn_worker(const wchar_t* python_home) {
+	auto w = new python_worker();
+	w->python_home = python_home;
+
+	wchar_t name[64];
+	swprintf_s(name, 64, L"FluminPythonWorker.%lu.%ld", GetCurrentProcessId(), InterlockedIncrement(&worker_counter));
+
+	wchar_t object_name[MAX_PATH];
+	worker_object_name(object_name, MAX_PATH, name, L"shm");
+	w->mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, WORKER_MAPPING_SIZE, object_name);
+	worker_object_name(object_name, MAX_PATH, name, L"request");
+	w->request = CreateEventW(NULL, FALSE, FALSE, object_name);
+	worker_object_name(object_name, MAX_PATH, name, L"reply");
+	w->reply = CreateEventW(NULL, FALSE, FALSE, object_name);
+
+	if (w->mapping == NULL || w->request == NULL || w->reply == NULL) {
+		destroy_worker(w);
+		return NULL;
+	}
+
+	w->header = (worker_header*) MapViewOfFile(w->mapping, FILE_MAP_ALL_ACCESS, 0, 0, WORKER_MAPPING_SIZE);
+	if (w->header == NULL) {
+		destroy_worker(w);
+		return NULL;
+	}
+
+	// the first request is pending before the worker even starts
+	w->header->command = WORKER_READY;
+	w->header->request_seq = 1;
+
+	auto exe = worker_executable();
+	auto command_line = L"\"" + exe + L"\" " + name + L" " + std::to_wstring(GetCurrentProcessId()) + L" \"" + w->python_home + L"\"";
+
+	STARTUPINFOW startup = { sizeof(STARTUPINFOW) };
+	PROCESS_INFORMATION info;
+	if (!CreateProcessW(exe.c_str(), &command_line[0], NULL, NULL, FALSE, CREATE_NO_WINDOW, NULL, NULL, &startup, &info)) {
+		destroy_worker(w);
+		return NULL;
+	}
+
+	CloseHandle(info.hThread);
+	w->process = info.hProcess;
+
+	if (wait_for(&w->header->reply_seq, 1, w->reply, w->process, STARTUP_TIMEOUT) != WORKER_OK || w->header->status != WORKER_OK) {
+		TerminateProcess(w->process, 1);
+		w->dead = true;
+		destroy_worker(w);
+		return NULL;
+	}
+
+	return w;
+}
+
+// hands out an idle worker started with the same python home or starts a new
+// one. Idle workers have not run any script yet. Returns NULL if the worker
+// could not be started
+EXPORTABLE python_worker* WorkerAcquire(const wchar_t* python_home) {
+	{
+		std::lock_guard<std::mutex> lock(pool_lock);
+		for (auto it = idle_workers.begin(); it != idle_workers.end(); ++it) {
+			auto w = *it;
+			if (w->python_home == python_home && WaitForSingleObject(w->process, 0) == WAIT_TIMEOUT) {
+				idle_workers.erase(it);
+				return w;
+			}
+		}
+	}
+
+	return spawn_worker(python_home);
+}
+
+// starts a worker for the pool on its own thread, so the next WorkerAcquire
+// doesn't wait for the interpreter to start up
+static void replenish_pool(const std::wstring& python_home) {
+	{
+		std::lock_guard<std::mutex> lock(pool_lock);
+		if ((int) idle_workers.size() + spawning_workers >= MAX_IDLE_WORKERS) return;
+		spawning_workers++;
+	}
+
+	std::thread([python_home]() {
+		auto w = spawn_worker(python_home.c_str());
+
+		std::lock_guard<std::mutex> lock(pool_lock);
+		spawning_workers--;
+		if (w != NULL) idle_workers.push_back(w);
+	}).detach();
+}
+
+// ends a worker. A script leaves its imports, sys.modules entries and
+// monkeypatches behind in the interpreter, so a worker is never handed to
+// another script. A fresh one takes its place in the pool
+EXPORTABLE void WorkerRelease(python_worker* w) {
+	if (w == NULL) return;
+
+	auto python_home = w->python_home;
+	destroy_worker(w);
+	replenish_pool(python_home);
+}
+
+EXPORTABLE int WorkerIsDead(python_worker* w) {
+	return w->dead;
+}
+
+EXPORTABLE int WorkerLoad(python_worker* w, const char* code, int size, DWORD timeout) {
+	if (size < 0 || size >= WORKER_CODE_SIZE) return WORKER_INVALID;
+
+	memcpy((char*) w->header + WORKER_CODE_OFFSET, code, size);
+	w->header->code_size = size;
+
+	return worker_call(w, WORKER_LOAD, timeout);
+}
+
+EXPORTABLE int WorkerInit(python_worker* w, DWORD timeout) {
+	return worker_call(w, WORKER_INIT, timeout);
+}
+
+static worker_port* host_port(python_worker* w, int output, int index) {
+	auto count = output ? w->header->output_count : w->header->input_count;
+	if (index < 0 || index >= count) return NULL;
+	return output ? &w->header->outputs[index] : &w->header->inputs[index];
+}
+
+EXPORTABLE int WorkerGetPortCount(python_worker* w, int output) {
+	return output ? w->header->output_count : w->header->input_count;
+}
+
+EXPORTABLE const char* WorkerGetPortName(python_worker* w, int output, int index) {
+	auto port = host_port(w, output, index);
+	return port != NULL ? port->name : NULL;
+}
+
+EXPORTABLE int WorkerGetPortKind(python_worker* w, int output, int index) {
+	auto port = host_port(w, output, index);
+	return port != NULL ? port->kind : -1;
+}
+
+EXPORTABLE int WorkerGetSamplerate(python_worker* w, int output, int index) {
+	auto port = host_port(w, output, index);
+	return port != NULL ? port->samplerate : 0;
+}
+
+// sets the samplerate and the ring size of a port. Inputs are set before
+// WorkerPrepare, outputs after it. The capacity is rounded up to a power of two.
+// read_limit caps the samples one ReadDataPort of an input returns
+EXPORTABLE int WorkerSetPort(python_worker* w, int output, int index, int samplerate, int capacity, int read_limit) {
+	auto port = host_port(w, output, index);
+	if (port == NULL || capacity < 0 || capacity > WORKER_RING_SIZE / (int) sizeof(double) || read_limit < 0) return WORKER_INVALID;
+
+	int rounded = capacity > 0 ? 1 : 0;
+	while (rounded < capacity) rounded <<= 1;
+
+	port->samplerate = samplerate;
+	port->read_limit = read_limit;
+	port->ring.capacity = port->kind == WORKER_PORT_DATA ? rounded : 0;
+	return WORKER_OK;
+}
+
+// calls prepare of the script, which may set the samplerates of the outputs
+EXPORTABLE int WorkerPrepare(python_worker* w, DWORD timeout) {
+	return worker_call(w, WORKER_PREPARE, timeout);
+}
+
+// places the rings of all ports in the shared memory once their sizes are set
+// with WorkerSetPort. Has to run after WorkerPrepare and before WorkerProcess
+EXPORTABLE int WorkerLayoutRings(python_worker* w) {
+	auto header = w->header;
+	int offset = WORKER_RING_OFFSET;
+
+	for (int output = 0; output < 2; output++) {
+		auto count = output ? header->output_count : header->input_count;
+		for (int i = 0; i < count; i++) {
+			auto& ring = host_port(w, output, i)->ring;
+			if (offset + ring.capacity * (int) sizeof(double) > WORKER_MAPPING_SIZE) {
+				set_error(header, "port buffers don't fit into the worker's shared memory", -1, -1);
+				return WORKER_INVALID;
+			}
+			ring.offset = offset;
+			ring.read_pos = 0;
+			ring.write_pos = 0;
+			offset += ring.capacity * sizeof(double);
+		}
+	}
+
+	return WORKER_OK;
+}
+
+EXPORTABLE int WorkerProcess(python_worker* w, DWORD timeout) {
+	return worker_call(w, WORKER_PROCESS, timeout);
+}
+
+// free space in the ring of an input port
+EXPORTABLE int WorkerFree(python_worker* w, int index) {
+	auto port = host_port(w, 0, index);
+	return port != NULL ? ring_free(&port->ring) : 0;
+}
+
+EXPORTABLE int WorkerWrite(python_worker* w, int index, const double* src, int count) {
+	auto port = host_port(w, 0, index);
+	return port != NULL ? ring_write(w->header, &port->ring, src, count) : 0;
+}
+
+// samples waiting in the ring of an output port
+EXPORTABLE int WorkerAvailable(python_worker* w, int index) {
+	auto port = host_port(w, 1, index);
+	return port != NULL ? ring_available(&port->ring) : 0;
+}
+
+EXPORTABLE int WorkerRead(python_worker* w, int index, double* dst, int count) {
+	auto port = host_port(w, 1, index);
+	return port != NULL ? ring_read(w->header, &port->ring, dst, count) : 0;
+}
+
+EXPORTABLE const char* WorkerGetError(python_worker* w) { return w->header->error; }
+EXPORTABLE int WorkerGetErrorLine(python_worker* w) { return w->header->error_line; }
+EXPORTABLE int WorkerGetErrorOffset(python_worker* w) { return w->header->error_offset; }
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <windows.h>
+
+// Layout of the shared memory between a host and a python worker process. The
+// mapping starts with the header, followed by the script and the port rings.
+// The host writes a command and bumps request_seq, the worker answers by
+// setting reply_seq to the same value. Both sides signal an auto-reset event
+// after bumping their counter, but check the counter first so that a fast
+// answer doesn't cost a kernel wait.
+
+#define WORKER_MAX_PORTS    16
+#define WORKER_NAME_LENGTH  64
+#define WORKER_ERROR_LENGTH 1024
+#define WORKER_CODE_SIZE    (1 << 20)
+#define WORKER_RING_SIZE    (32 << 20)
+
+enum worker_command {
+	WORKER_READY,       // sent once by the worker after start up
+	WORKER_LOAD,
+	WORKER_INIT,
+	WORKER_PREPARE,
+	WORKER_PROCESS,
+	WORKER_EXIT
+};
+
+enum worker_status {
+	WORKER_OK,
+	WORKER_PYTHON_ERROR,
+	WORKER_TIMEOUT,
+	WORKER_DIED,
+	WORKER_INVALID
+};
+
+enum worker_port_kind {
+	WORKER_PORT_DATA,
+	WORKER_PORT_VALUE
+};
+
+// single producer, single consumer. Positions only grow, the capacity is a
+// power of two so they can wrap around 2^32
+struct worker_ring {
+	volatile LONG read_pos;
+	volatile LONG write_pos;
+	int capacity;
+	int offset;             // of the samples from the start of the mapping
+};
+
+struct worker_port {
+	char name[WORKER_NAME_LENGTH];
+	int kind;
+	int samplerate;
+	int read_limit;         // most samples one ReadDataPort hands to the script
+	worker_ring ring;
+};
+
+struct worker_header {
+	volatile LONG request_seq;
+	volatile LONG reply_seq;
+	int command;
+	int status;
+
+	char error[WORKER_ERROR_LENGTH];
+	int error_line;
+	int error_offset;
+
+	int code_size;
+	int input_count;
+	int output_count;
+	worker_port inputs[WORKER_MAX_PORTS];
+	worker_port outputs[WORKER_MAX_PORTS];
+};
+
+#define WORKER_CODE_OFFSET  ((int) ((sizeof(worker_header) + 63) & ~63))
+#define WORKER_RING_OFFSET  (WORKER_CODE_OFFSET + WORKER_CODE_SIZE)
+#define WORKER_MAPPING_SIZE (WORKER_RING_OFFSET + WORKER_RING_SIZE)
+
+inline double* ring_data(worker_header* header, worker_ring* ring) {
+	return (double*) ((char*) header + ring->offset);
+}
+
+inline int ring_available(worker_ring* ring) {
+	return (int) ((unsigned) ring->write_pos - (unsigned) ring->read_pos);
+}
+
+inline int ring_free(worker_ring* ring) {
+	return ring->capacity - ring_available(ring);
+}
+
+// copies up to count samples into the ring and returns how many fit
+inline int ring_write(worker_header* header, worker_ring* ring, const double* src, int count) {
+	if (ring->capacity == 0) return 0;
+
+	count = min(count, ring_free(ring));
+	auto data = ring_data(header, ring);
+	auto start = (unsigned) ring->write_pos & (ring->capacity - 1);
+	auto first = min(count, ring->capacity - (int) start);
+
+	memcpy(data + start, src, first * sizeof(double));
+	memcpy(data, src + first, (count - first) * sizeof(double));
+
+	// the samples have to be visible before the position moves
+	InterlockedExchange(&ring->write_pos, (LONG) ((unsigned) ring->write_pos + count));
+	return count;
+}
+
+// copies up to count samples out of the ring and returns how many there were
+inline int ring_read(worker_header* header, worker_ring* ring, double* dst, int count) {
+	if (ring->capacity == 0) return 0;
+
+	count = min(count, ring_available(ring));
+	auto data = ring_data(header, ring);
+	auto start = (unsigned) ring->read_pos & (ring->capacity - 1);
+	auto first = min(count, ring->capacity - (int) start);
+
+	memcpy(dst, data + start, first * sizeof(double));
+	memcpy(dst + first, data, (count - first) * sizeof(double));
+
+	InterlockedExchange(&ring->read_pos, (LONG) ((unsigned) ring->read_pos + count));
+	return count;
+}
+
+// object names of the mapping and the two events of a worker
+inline void worker_object_name(wchar_t* dst, int size, const wchar_t* base, const wchar_t* suffix) {
+	swprintf_s(dst, size, L"Local\\%s.%s", base, suffix);
+}
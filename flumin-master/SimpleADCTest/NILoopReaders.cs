@@ -0,0 +1,122 @@
+﻿using System;
+using System.Diagnostics;
+using System.IO;
+using System.Text;
+using System.Threading;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+using DeviceLibrary;
+
+namespace SimpleADCTest {
+    [TestClass]
+    public class NILoopReaders {
+
+        private const int SamplesPerChannel = 100;
+        private const int Records = 50;
+
+        private volatile bool _stop;
+
+        // one channel recorded like NILoop's recorder does, the task replays
+        // it in place of a device
+        private static string WriteRecording() {
+            var path = Path.GetTempFileName();
+
+            using (var writer = new BinaryWriter(File.Create(path))) {
+                writer.Write(Encoding.ASCII.GetBytes("NIRC"));
+                writer.Write(3);    // RECORD_VERSION
+                writer.Write((int)NILoop.TASK_TYPE.TASK_TYPE_ANALOG_INPUT);
+                writer.Write((int)NILoop.SAMPLE_FORMAT.SAMPLE_FORMAT_DEFAULT);
+                writer.Write(SamplesPerChannel);
+                writer.Write(SamplesPerChannel);
+                writer.Write(1);    // channels
+                writer.Write(0);    // scaling coefficients
+                writer.Write(Stopwatch.Frequency);
+
+                for (int r = 0; r < Records; r++) {
+                    writer.Write((long)r);
+                    writer.Write((long)r * Stopwatch.Frequency / 1000);
+                    writer.Write((long)r * SamplesPerChannel);
+                    writer.Write(SamplesPerChannel);
+                    writer.Write(SamplesPerChannel);
+                    writer.Write(SamplesPerChannel * sizeof(double));
+                    writer.Write(0);    // padding of record_header
+
+                    for (int i = 0; i < SamplesPerChannel; i++) {
+                        writer.Write((double)i);
+                    }
+                }
+            }
+
+            return path;
+        }
+
+        [TestMethod]
+        public void register_readers_while_running() {
+            var path = WriteRecording();
+
+            var handles = new[] {
+                new NILoop.HandleInfo {
+                    handle              = 1,
+                    type                = (int)NILoop.TASK_TYPE.TASK_TYPE_ANALOG_INPUT,
+                    samples_per_chan    = SamplesPerChannel,
+                    buffer_size         = SamplesPerChannel,
+                    pool_depth          = 4,
+                    thread_group        = NILoop.THREAD_GROUP_OWN,
+                    replay_path         = path,
+                    replay_mode         = (int)NILoop.REPLAY_MODE.REPLAY_MODE_FAST,
+                    replay_loop         = 1
+                }
+            };
+
+            int hPoll;
+            try {
+                hPoll = NILoop.start_polling(handles, handles.Length);
+            } catch (DllNotFoundException) {
+                File.Delete(path);
+                Assert.Inconclusive("NILoop.dll not found");
+                return;
+            }
+
+            Assert.AreNotEqual(0, hPoll, "start_polling must succeed");
+
+            var task = handles[0].handle;
+            var reader = NILoop.register_reader(hPoll, task);
+            Assert.IsTrue(reader >= 0);
+
+            // keeps the pool moving while the other readers come and go
+            long taken = 0;
+            var consumer = new Thread(() => {
+                NILoop.BufferLease lease;
+                while (!_stop) {
+                    if (NILoop.wait_reader(hPoll, task, reader, 100) != 0) continue;
+                    if (NILoop.acquire_reader_buffer(hPoll, task, reader, out lease) == 0) {
+                        NILoop.release_reader_buffer(hPoll, task, reader, lease.id);
+                        Interlocked.Increment(ref taken);
+                    }
+                }
+            });
+            consumer.Start();
+
+            for (int i = 0; i < 5000; i++) {
+                var other = NILoop.register_reader(hPoll, task);
+                Assert.IsTrue(other >= 0);
+                Assert.AreEqual(0, NILoop.unregister_reader(hPoll, task, other));
+            }
+
+            // a buffer waiting for a reader that never takes it holds up every
+            // later one, the pool would run dry for good
+            var before = Interlocked.Read(ref taken);
+            Thread.Sleep(500);
+            var after = Interlocked.Read(ref taken);
+
+            _stop = true;
+            consumer.Join();
+
+            NILoop.unregister_reader(hPoll, task, reader);
+            NILoop.stop_polling(hPoll);
+            File.Delete(path);
+
+            Assert.IsTrue(after > before, "buffers must keep coming after readers registered while the task ran");
+        }
+
+    }
+}
@@ -0,0 +1,139 @@
+﻿using System;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+using NodeSystemLib2;
+using NodeSystemLib2.FormatData1D;
+
+namespace SimpleADCTest {
+    [TestClass]
+    public class RingBufferSegments {
+
+        private static void Fill(RingBuffer<int> ring, int count, int first) {
+            var data = new int[count];
+            for (int i = 0; i < count; i++) {
+                data[i] = first + i;
+            }
+            ring.Write(data, 0, count);
+        }
+
+        [TestMethod]
+        public void read_segments_wrapped() {
+            var ring = new RingBuffer<int>(8);
+
+            Fill(ring, 6, 0);
+            Assert.AreEqual(4, ring.Consume(4));
+            Fill(ring, 5, 6);
+
+            int offset, count1, count2;
+            var data = ring.GetReadSegments(out offset, out count1, out count2);
+
+            Assert.AreEqual(4, offset);
+            Assert.AreEqual(4, count1);
+            Assert.AreEqual(3, count2);
+            Assert.AreEqual(ring.Available, count1 + count2);
+
+            for (int i = 0; i < count1; i++) {
+                Assert.AreEqual(4 + i, data[offset + i]);
+            }
+            for (int i = 0; i < count2; i++) {
+                Assert.AreEqual(4 + count1 + i, data[i]);
+            }
+
+            Assert.AreEqual(5, ring.Consume(5));
+            Assert.AreEqual(1, ring.ReadPosition);
+            Assert.AreEqual(2, ring.Available);
+        }
+
+        [TestMethod]
+        public void read_segments_full() {
+            var ring = new RingBuffer<int>(8);
+
+            Fill(ring, 3, 0);
+            ring.Consume(3);
+            Fill(ring, 8, 3);
+
+            int offset, count1, count2;
+            ring.GetReadSegments(out offset, out count1, out count2);
+
+            Assert.AreEqual(3, offset);
+            Assert.AreEqual(5, count1);
+            Assert.AreEqual(3, count2);
+
+            ring.GetWriteSegments(out offset, out count1, out count2);
+
+            Assert.AreEqual(0, count1);
+            Assert.AreEqual(0, count2);
+            Assert.AreEqual(0, ring.Commit(1));
+            Assert.AreEqual(8, ring.Available);
+
+            Assert.AreEqual(8, ring.Consume(20));
+            Assert.AreEqual(0, ring.Available);
+            Assert.AreEqual(0, ring.Consume(1));
+        }
+
+        [TestMethod]
+        public void write_segments_wrapped() {
+            var ring = new RingBuffer<int>(8);
+
+            Fill(ring, 5, 0);
+            ring.Consume(3);
+
+            int offset, count1, count2;
+            var data = ring.GetWriteSegments(out offset, out count1, out count2);
+
+            Assert.AreEqual(5, offset);
+            Assert.AreEqual(3, count1);
+            Assert.AreEqual(3, count2);
+
+            for (int i = 0; i < count1; i++) {
+                data[offset + i] = 5 + i;
+            }
+            for (int i = 0; i < count2; i++) {
+                data[i] = 5 + count1 + i;
+            }
+
+            Assert.AreEqual(6, ring.Commit(count1 + count2));
+            Assert.AreEqual(8, ring.Available);
+            Assert.AreEqual(3, ring.WritePosition);
+
+            var read = new int[8];
+            Assert.AreEqual(8, ring.Read(read, 0, read.Length));
+            for (int i = 0; i < read.Length; i++) {
+                Assert.AreEqual(3 + i, read[i]);
+            }
+        }
+
+        [TestMethod]
+        public void commit_clamped_to_free() {
+            var ring = new RingBuffer<int>(8);
+
+            Fill(ring, 6, 0);
+
+            Assert.AreEqual(2, ring.Commit(5));
+            Assert.AreEqual(8, ring.Available);
+            Assert.AreEqual(0, ring.Free);
+        }
+
+        [TestMethod]
+        public void commit_advances_time() {
+            var rate = 1000;
+            var ring = new RingBuffer1D<double>(rate, rate);
+
+            int offset, count1, count2;
+            ring.GetWriteSegments(out offset, out count1, out count2);
+            Assert.AreEqual(rate, count1);
+
+            Assert.AreEqual(250, ring.Commit(250));
+            Assert.AreEqual(0.25, ring.Time.AsSeconds(), 1e-9);
+
+            Assert.AreEqual(750, ring.Commit(1000));
+            Assert.AreEqual(1.0, ring.Time.AsSeconds(), 1e-9);
+
+            Assert.AreEqual(0, ring.Commit(1));
+            Assert.AreEqual(1.0, ring.Time.AsSeconds(), 1e-9);
+
+            ring.Consume(500);
+            Assert.AreEqual(1.0, ring.Time.AsSeconds(), 1e-9);
+        }
+
+    }
+}